@@ -4,5 +4,6 @@
 #include "board.h"
 
 int is_square_attacked(Board *board, int square);
+uint64_t attackers_to(const Board *board, int square, uint64_t occupancy);
 
 #endif
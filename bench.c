@@ -0,0 +1,56 @@
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "game.h"
+#include "search.h"
+#include "tt.h"
+
+// Openings, middlegames and endgames, with castling, en passant and promotions in reach
+const char *benchPositions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+	"r1bq1rk1/pp2ppbp/2np1np1/8/3NP3/2N1BP2/PPPQ2PP/R3KB1R w KQ - 3 9",
+	"2r3k1/pp3ppp/2n5/3p4/3P4/2P2N2/P4PPP/2R3K1 b - - 0 20",
+	"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+	"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",
+	"8/5pk1/6p1/7p/P6P/6P1/5PK1/8 w - - 0 40",
+};
+
+#define BENCH_POSITIONS (int)(sizeof(benchPositions) / sizeof(benchPositions[0]))
+const int benchPositionCount = BENCH_POSITIONS;
+
+void bench(int depth) {
+	Game *game = aligned_alloc(64, sizeof(Game)); // Board is 64-byte aligned, malloc only gives 16
+	unsigned long long totalNodes = 0;
+
+	// One thread, helpers would make the node count vary from run to run
+	int threads = search_threads();
+	search_set_threads(1);
+
+	// Start from an empty hash table and history, later positions still see what earlier ones left
+	tt_clear();
+	search_clear();
+
+	double startTime = omp_get_wtime();
+	for (int i = 0; i < BENCH_POSITIONS; i++) {
+		printf("info string Position %d/%d: %s\n", i + 1, BENCH_POSITIONS, benchPositions[i]);
+		game_setFEN(game, benchPositions[i]);
+		searchBestMove(game, NULL, depth);
+		totalNodes += nodeCount;
+	}
+	double elapsedTime = omp_get_wtime() - startTime;
+
+	search_set_threads(threads);
+	free(game);
+
+	printf("\n===========================\n");
+	printf("Total time (ms) : %.0f\n", elapsedTime * 1000);
+	printf("Nodes searched  : %llu\n", totalNodes);
+	printf("Nodes/second    : %.0f\n", elapsedTime > 0 ? totalNodes / elapsedTime : 0.0);
+}
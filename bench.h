@@ -0,0 +1,14 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_DEFAULT_DEPTH 5
+
+// The built-in positions, also the seeds of the microbench corpus
+extern const char *benchPositions[];
+extern const int benchPositionCount;
+
+// Search the built-in positions to depth on one thread and print total nodes, time and nps.
+// The node total is a signature of the search: it only changes when the search does.
+void bench(int depth);
+
+#endif
@@ -0,0 +1,171 @@
+#include "bitboard.h"
+#include "board.h"
+#include "cpu.h"
+
+Magic bishopMagics[64];
+Magic rookMagics[64];
+
+uint64_t knightAttacks[64];
+uint64_t kingAttacks[64];
+uint64_t pawnAttacks[2][64];
+
+uint64_t squaresBetween[64][64];
+uint64_t lineThrough[64][64];
+
+int usePext;
+
+// Attack tables for all squares, indexed through Magic.attacks.
+// 5248 and 102400 are the summed 2^bits over all squares for bishops and rooks.
+static uint64_t bishopTable[5248];
+static uint64_t rookTable[102400];
+
+static const int bishopDirections[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+static const int rookDirections[4][2] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+
+static const int knightOffsets[8][2] = {{-2, 1}, {-1, 2}, {1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}};
+static const int kingOffsets[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+
+// Set of on-board squares reached from square by the given rank/file offsets
+static uint64_t leaper_attacks(int square, const int offsets[][2], int count) {
+	uint64_t attacks = 0;
+	for (int i = 0; i < count; i++) {
+		int rank = square / 8 + offsets[i][0];
+		int file = square % 8 + offsets[i][1];
+		if (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+			attacks |= 1ULL << (rank * 8 + file);
+		}
+	}
+	return attacks;
+}
+
+// Walk the rays one square at a time, stopping at the first blocker.
+// Only used to fill the tables.
+static uint64_t sliding_attacks(int square, uint64_t occupancy, const int directions[4][2]) {
+	uint64_t attacks = 0;
+	for (int i = 0; i < 4; i++) {
+		int rank = square / 8 + directions[i][0];
+		int file = square % 8 + directions[i][1];
+		while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+			uint64_t mask = 1ULL << (rank * 8 + file);
+			attacks |= mask;
+			if (occupancy & mask) {
+				break;
+			}
+			rank += directions[i][0];
+			file += directions[i][1];
+		}
+	}
+	return attacks;
+}
+
+// xorshift64*, reseeded per rank with seeds known to find magics quickly
+static const uint64_t magicSeeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+static uint64_t magicSeed;
+static uint64_t random_uint64() {
+	magicSeed ^= magicSeed >> 12;
+	magicSeed ^= magicSeed << 25;
+	magicSeed ^= magicSeed >> 27;
+	return magicSeed * 0x2545F4914F6CDD1DULL;
+}
+
+// Good magic candidates have few bits set
+static uint64_t random_sparse_uint64() {
+	return random_uint64() & random_uint64() & random_uint64();
+}
+
+static void init_magics(Magic magics[64], uint64_t *table, const int directions[4][2]) {
+	uint64_t occupancies[4096];
+	uint64_t references[4096];
+	int epoch[4096] = {0};
+	int attempt = 0;
+
+	for (int square = 0; square < 64; square++) {
+		Magic *m = &magics[square];
+		int rank = square / 8;
+		int file = square % 8;
+
+		// Edge squares never block anything beyond them, unless the piece stands on that edge
+		uint64_t edges = ((0x00000000000000FFULL | 0xFF00000000000000ULL) & ~(0x00000000000000FFULL << (rank * 8))) |
+						 ((0x0101010101010101ULL | 0x8080808080808080ULL) & ~(0x0101010101010101ULL << file));
+		m->mask = sliding_attacks(square, 0, directions) & ~edges;
+		m->shift = 64 - __builtin_popcountll(m->mask);
+		m->attacks = table;
+
+		// Enumerate every subset of the mask (Carry-Rippler) with its reference attack set
+		int size = 0;
+		uint64_t subset = 0;
+		do {
+			occupancies[size] = subset;
+			references[size] = sliding_attacks(square, subset, directions);
+			size++;
+			subset = (subset - m->mask) & m->mask;
+		} while (subset);
+
+		// With PEXT the index is the subset's bits packed down, no magic needed
+		if (usePext) {
+			m->magic = 0;
+			for (int i = 0; i < size; i++) {
+				m->attacks[slider_index(m, occupancies[i])] = references[i];
+			}
+			table += size;
+			continue;
+		}
+
+		// Try random magics until one maps all subsets without a destructive collision
+		magicSeed = magicSeeds[rank];
+		int i = 0;
+		while (i < size) {
+			do {
+				m->magic = random_sparse_uint64();
+			} while (__builtin_popcountll((m->mask * m->magic) >> 56) < 6);
+
+			attempt++;
+			for (i = 0; i < size; i++) {
+				unsigned index = (unsigned)(((occupancies[i] & m->mask) * m->magic) >> m->shift);
+				if (epoch[index] < attempt) {
+					epoch[index] = attempt;
+					m->attacks[index] = references[i];
+				} else if (m->attacks[index] != references[i]) {
+					break;
+				}
+			}
+		}
+
+		table += size;
+	}
+}
+
+void init_bitboards() {
+	const int whitePawnOffsets[2][2] = {{1, -1}, {1, 1}};
+	const int blackPawnOffsets[2][2] = {{-1, -1}, {-1, 1}};
+
+	usePext = cpuFeatures.bmi2;
+
+	for (int square = 0; square < 64; square++) {
+		knightAttacks[square] = leaper_attacks(square, knightOffsets, 8);
+		kingAttacks[square] = leaper_attacks(square, kingOffsets, 8);
+		pawnAttacks[WHITE][square] = leaper_attacks(square, whitePawnOffsets, 2);
+		pawnAttacks[BLACK][square] = leaper_attacks(square, blackPawnOffsets, 2);
+	}
+
+	init_magics(bishopMagics, bishopTable, bishopDirections);
+	init_magics(rookMagics, rookTable, rookDirections);
+
+	for (int from = 0; from < 64; from++) {
+		for (int to = 0; to < 64; to++) {
+			uint64_t toMask = 1ULL << to;
+			squaresBetween[from][to] = 0;
+			lineThrough[from][to] = 0;
+			if (from == to) {
+				continue;
+			}
+			if (bishop_attacks(from, 0) & toMask) {
+				squaresBetween[from][to] = bishop_attacks(from, toMask) & bishop_attacks(to, 1ULL << from);
+				lineThrough[from][to] = (bishop_attacks(from, 0) & bishop_attacks(to, 0)) | (1ULL << from) | toMask;
+			} else if (rook_attacks(from, 0) & toMask) {
+				squaresBetween[from][to] = rook_attacks(from, toMask) & rook_attacks(to, 1ULL << from);
+				lineThrough[from][to] = (rook_attacks(from, 0) & rook_attacks(to, 0)) | (1ULL << from) | toMask;
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+// Magic bitboard entry for one square of a sliding piece
+typedef struct {
+  uint64_t mask;     // relevant occupancy, board edges excluded
+  uint64_t magic;    // multiplier that maps each occupancy subset to a unique index
+  uint64_t *attacks; // this square's slice of the shared attack table
+  int shift;         // 64 - number of bits in mask
+} Magic;
+
+extern Magic bishopMagics[64];
+extern Magic rookMagics[64];
+
+// Leaper attacks by square; pawnAttacks is indexed by the color of the attacking pawn
+extern uint64_t knightAttacks[64];
+extern uint64_t kingAttacks[64];
+extern uint64_t pawnAttacks[2][64];
+
+// Squares strictly between two squares on a common rank, file or diagonal (0 otherwise)
+extern uint64_t squaresBetween[64][64];
+// The whole rank, file or diagonal through two aligned squares (0 otherwise)
+extern uint64_t lineThrough[64][64];
+
+// Set by init_bitboards when the slider tables are indexed with PEXT instead of the magic multiply
+extern int usePext;
+
+// Build the attack tables, call once at startup after init_cpu
+void init_bitboards();
+
+#if defined(__x86_64__)
+// BMI2 parallel bit extract. Inline asm keeps the rest of the binary free of -mbmi2;
+// only reached when usePext is set.
+static inline uint64_t pext(uint64_t value, uint64_t mask) {
+	uint64_t result;
+	__asm__("pextq %2, %1, %0" : "=r"(result) : "r"(value), "rm"(mask));
+	return result;
+}
+#endif
+
+// Index of an occupancy in a square's slice of the attack table
+static inline unsigned slider_index(const Magic *m, uint64_t occupancy) {
+#if defined(__x86_64__)
+	if (usePext) {
+		return (unsigned)pext(occupancy, m->mask);
+	}
+#endif
+	return (unsigned)(((occupancy & m->mask) * m->magic) >> m->shift);
+}
+
+static inline uint64_t bishop_attacks(int square, uint64_t occupancy) {
+	const Magic *m = &bishopMagics[square];
+	return m->attacks[slider_index(m, occupancy)];
+}
+
+static inline uint64_t rook_attacks(int square, uint64_t occupancy) {
+	const Magic *m = &rookMagics[square];
+	return m->attacks[slider_index(m, occupancy)];
+}
+
+static inline uint64_t queen_attacks(int square, uint64_t occupancy) {
+	return bishop_attacks(square, occupancy) | rook_attacks(square, occupancy);
+}
+
+#endif
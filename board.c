@@ -1,4 +1,6 @@
+#include <string.h>
 #include "board.h"
+#include "bitboard.h"
 #include "zobrist.h"
 
 #define INITIAL_POSITION_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
@@ -9,15 +11,7 @@ void initializeBoard(Board *board) {
 
 void setBoardtoFEN(Board *board, const char *fen) {
 	// Reset all the pieces and occupied squares
-	for (int i = 0; i < 2; ++i) {
-		board->pawns[i] = 0;
-		board->knights[i] = 0;
-		board->bishops[i] = 0;
-		board->rooks[i] = 0;
-		board->queens[i] = 0;
-		board->kings[i] = 0;
-		board->occupied[i] = 0;
-	}
+	memset(board, 0, sizeof(*board));
 
 	board->sideToMove = WHITE;
 	board->enPassantSquare = -1;
@@ -27,49 +21,18 @@ void setBoardtoFEN(Board *board, const char *fen) {
 	int rank = 7;
 	int file = 0;
 
+	// Piece letters in Piece order (PAWN ... KING), white then black
+	const char *pieceLetters = "PNBRQKpnbrqk";
+
 	while (*fen != ' ') {
-		switch (*fen) {
-		case 'p':
-			board->pawns[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'n':
-			board->knights[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'b':
-			board->bishops[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'r':
-			board->rooks[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'q':
-			board->queens[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'k':
-			board->kings[BLACK] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'P':
-			board->pawns[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'N':
-			board->knights[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'B':
-			board->bishops[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'R':
-			board->rooks[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'Q':
-			board->queens[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case 'K':
-			board->kings[WHITE] |= 1ULL << (rank * 8 + file);
-			break;
-		case '/':
+		const char *letter = strchr(pieceLetters, *fen);
+		if (*fen == '/') {
 			rank -= 1;
-			file = -1;
-			break; // go to the next rank, reset the file
-		default:
+			file = -1; // go to the next rank, reset the file
+		} else if (letter != NULL) {
+			int index = letter - pieceLetters;
+			placePiece(board, index / 6, PAWN + index % 6, rank * 8 + file);
+		} else {
 			file += *fen - '0' - 1; // handle numbers (empty squares)
 		}
 
@@ -112,7 +75,13 @@ void setBoardtoFEN(Board *board, const char *fen) {
 	if (*fen != '-') {
 		file = fen[0] - 'a';
 		rank = (fen[1] - '1');
-		board->enPassantSquare = rank * 8 + file;
+		// Kept only when a pawn can capture there, as make_move does, so the key doesn't
+		// depend on whether the position came from a FEN or from moves
+		int square = rank * 8 + file;
+		int mover = board->sideToMove ^ 1;
+		if (pawnAttacks[mover][square] & board->bb[board->sideToMove][PAWN]) {
+			board->enPassantSquare = square;
+		}
 		fen += 3; // skip the en passant square
 	} else {
 		fen += 2; // skip the dash
@@ -121,10 +90,8 @@ void setBoardtoFEN(Board *board, const char *fen) {
 	// Skip any remaining parts of the FEN string
 	// (halfmove clock, fullmove number)
 
-	// Update occupied squares
-	board->occupied[WHITE] = board->pawns[WHITE] | board->knights[WHITE] | board->bishops[WHITE] | board->rooks[WHITE] | board->queens[WHITE] | board->kings[WHITE];
-	board->occupied[BLACK] = board->pawns[BLACK] | board->knights[BLACK] | board->bishops[BLACK] | board->rooks[BLACK] | board->queens[BLACK] | board->kings[BLACK];
-
 	// In setBoardtoFEN
 	board->zobristKey = compute_zobrist_key(board);
+	board->pawnKey = compute_pawn_key(board);
+	board->materialKey = compute_material_key(board);
 }
@@ -7,21 +7,47 @@
 #define WHITE 0
 #define BLACK 1
 
+typedef enum { EMPTY = 0, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING } Piece;
+
+// bb[color][ALL_PIECES] holds every piece of that color
+#define ALL_PIECES EMPTY
+
+// Laid out so the bitboards, the keys and the mailbox share as few cache lines as possible
 typedef struct {
-  uint64_t pawns[2];    // lsb is a1
-  uint64_t knights[2];  // lsb is a1
-  uint64_t bishops[2];  // lsb is a1
-  uint64_t rooks[2];    // lsb is a1
-  uint64_t queens[2];   // lsb is a1
-  uint64_t kings[2];    // lsb is a1
-  uint64_t occupied[2]; // lsb is a1
-  int sideToMove;       // 0 for white, 1 for black
-  int enPassantSquare;  // store the file number of the en passant square, -1 if none
-  int castleRights[2];  // Store castling rights.
-  uint64_t zobristKey;  // This will be useful later for the transposition table
-} Board;
+  uint64_t bb[2][7];        // [color][piece type], lsb is a1
+  uint64_t zobristKey;      // This will be useful later for the transposition table
+  uint64_t pawnKey;         // zobrist key of the pawns alone, for pawn structure caches
+  uint64_t materialKey;     // zobrist key of the piece counts, for material tables
+  uint8_t squares[64];      // mailbox: piece type on each square, EMPTY if none
+  uint8_t sideToMove;       // 0 for white, 1 for black
+  int8_t enPassantSquare;   // store the file number of the en passant square, -1 if none
+  uint8_t castleRights[2];  // Store castling rights.
+} __attribute__((aligned(64))) Board;
 
 void initializeBoard(Board *board);
 void setBoardtoFEN(Board *board, const char *fen);
 
+// Piece updates are plain XORs on the bitboards plus a mailbox store
+static inline void placePiece(Board *board, int side, int piece, int square) {
+	uint64_t mask = 1ULL << square;
+	board->bb[side][piece] ^= mask;
+	board->bb[side][ALL_PIECES] ^= mask;
+	board->squares[square] = piece;
+}
+
+static inline void removePiece(Board *board, int side, int piece, int square) {
+	uint64_t mask = 1ULL << square;
+	board->bb[side][piece] ^= mask;
+	board->bb[side][ALL_PIECES] ^= mask;
+	board->squares[square] = EMPTY;
+}
+
+static inline void movePiece(Board *board, int side, int piece, int from, int to) {
+	uint64_t mask = (1ULL << from) | (1ULL << to);
+	board->bb[side][piece] ^= mask;
+	board->bb[side][ALL_PIECES] ^= mask;
+	board->squares[from] = EMPTY;
+	board->squares[to] = piece;
+}
+
 #endif
@@ -0,0 +1,20 @@
+#include "cpu.h"
+
+CpuFeatures cpuFeatures;
+
+void init_cpu() {
+	// Built with -DCPU_GENERIC (make generic) every feature stays off and only the portable paths run
+#if defined(__x86_64__) && !defined(CPU_GENERIC)
+	__builtin_cpu_init();
+	// PEXT is microcoded on AMD before Zen 3 and loses to the magic multiply there
+	cpuFeatures.bmi2 = __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amdfam17h");
+	cpuFeatures.avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+const char *cpu_path_name() {
+	if (cpuFeatures.bmi2) {
+		return cpuFeatures.avx2 ? "sliders pext, evaluation avx2" : "sliders pext, evaluation generic";
+	}
+	return cpuFeatures.avx2 ? "sliders magic, evaluation avx2" : "sliders magic, evaluation generic";
+}
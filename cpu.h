@@ -0,0 +1,20 @@
+#ifndef CPU_H
+#define CPU_H
+
+// Instruction set extensions found at startup. The binary itself is built for
+// plain x86-64; kernels that need more carry their own target attributes and
+// are only called when the matching flag is set.
+typedef struct {
+  int bmi2; // PEXT slider indexing
+  int avx2; // vector evaluation kernel
+} CpuFeatures;
+
+extern CpuFeatures cpuFeatures;
+
+// Detect the CPU, call once at startup before the other init functions
+void init_cpu();
+
+// The code paths picked for this CPU, for the uci output
+const char *cpu_path_name();
+
+#endif
@@ -1,5 +1,9 @@
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include "evaluate.h"
 #include "board.h"
+#include "cpu.h"
 
 #define PAWN_VALUE 100
 #define KNIGHT_VALUE 320
@@ -7,25 +11,9 @@
 #define ROOK_VALUE 510
 #define QUEEN_VALUE 950
 #define KING_VALUE 10000
-int evaluate_material(Board *board) {
 
-	int score = 0;
-
-	score += __builtin_popcountll(board->pawns[WHITE]) * PAWN_VALUE;
-	score -= __builtin_popcountll(board->pawns[BLACK]) * PAWN_VALUE;
-	score += __builtin_popcountll(board->knights[WHITE]) * KNIGHT_VALUE;
-	score -= __builtin_popcountll(board->knights[BLACK]) * KNIGHT_VALUE;
-	score += __builtin_popcountll(board->bishops[WHITE]) * BISHOP_VALUE;
-	score -= __builtin_popcountll(board->bishops[BLACK]) * BISHOP_VALUE;
-	score += __builtin_popcountll(board->rooks[WHITE]) * ROOK_VALUE;
-	score -= __builtin_popcountll(board->rooks[BLACK]) * ROOK_VALUE;
-	score += __builtin_popcountll(board->queens[WHITE]) * QUEEN_VALUE;
-	score -= __builtin_popcountll(board->queens[BLACK]) * QUEEN_VALUE;
-	score += __builtin_popcountll(board->kings[WHITE]) * KING_VALUE;
-	score -= __builtin_popcountll(board->kings[BLACK]) * KING_VALUE;
-
-	return score;
-}
+// Material values indexed by piece type (EMPTY, PAWN ... KING)
+const int pieceValues[7] = {0, PAWN_VALUE, KNIGHT_VALUE, BISHOP_VALUE, ROOK_VALUE, QUEEN_VALUE, KING_VALUE};
 
 #define DEVELOPED_KNIGHT_BONUS 10
 #define CENTRAL_KNIGHT_BONUS 10
@@ -36,52 +24,97 @@ int evaluate_material(Board *board) {
 #define RIM_SQUARES 0x7E8181818181817EULL			 // Bitboard with the rim squares set
 #define WHITE_DEVELOPED_SQUARES 0x0000000000240000LL // bitboard with c3, f3 set
 #define BLACK_DEVELOPED_SQUARES 0x0000240000000000LL // bitboard with c6, f6 set
-int evaluate_knight_position(Board *board) {
-
-	int score = 0;
-
-	// Apply bonus for centralized knights and penalty for corner knights
-	uint64_t whiteKnights = board->knights[WHITE];
-	uint64_t blackKnights = board->knights[BLACK];
-
-	score += CENTRAL_KNIGHT_BONUS * __builtin_popcountll(whiteKnights & CENTRAL_SQUARES);
-	score -= CENTRAL_KNIGHT_BONUS * __builtin_popcountll(blackKnights & CENTRAL_SQUARES);
-	// Apply bonus for developed knights
-	score += DEVELOPED_KNIGHT_BONUS * __builtin_popcountll(whiteKnights & WHITE_DEVELOPED_SQUARES);
-	score -= DEVELOPED_KNIGHT_BONUS * __builtin_popcountll(blackKnights & BLACK_DEVELOPED_SQUARES);
-
-	score -= CORNER_KNIGHT_PENALTY * __builtin_popcountll(whiteKnights & CORNER_SQUARES);
-	score += CORNER_KNIGHT_PENALTY * __builtin_popcountll(blackKnights & CORNER_SQUARES);
-	// Apply penalty for rim knights
-	score -= RIM_KNIGHT_PENALTY * __builtin_popcountll(whiteKnights & RIM_SQUARES);
-	score += RIM_KNIGHT_PENALTY * __builtin_popcountll(blackKnights & RIM_SQUARES);
-
-	return score;
-}
-
 
 #define PAWN_ADVANCED_BONUS 20
 #define WHITE_PAWN_ADVANCED_ROWS 0x00FFFF0000000000ULL // Sixth and seventh rows for white
 #define BLACK_PAWN_ADVANCED_ROWS 0x0000000000FFFF00ULL // Second and third rows for black
-int evaluate_pawn_position(Board *board) {
 
+#define ALL_SQUARES 0xFFFFFFFFFFFFFFFFULL
+
+// One evaluation term: weight * popcount(bb[color][piece] & mask), from white's point of view
+typedef struct {
+  int color;
+  int piece;
+  uint64_t mask;
+  int64_t weight;
+} EvalTerm;
+
+// Padded with zero terms to a multiple of four for the AVX2 kernel
+#define EVAL_TERMS 24
+static const EvalTerm evalTerms[EVAL_TERMS] = {
+	// Material
+	{WHITE, PAWN, ALL_SQUARES, PAWN_VALUE}, {BLACK, PAWN, ALL_SQUARES, -PAWN_VALUE},
+	{WHITE, KNIGHT, ALL_SQUARES, KNIGHT_VALUE}, {BLACK, KNIGHT, ALL_SQUARES, -KNIGHT_VALUE},
+	{WHITE, BISHOP, ALL_SQUARES, BISHOP_VALUE}, {BLACK, BISHOP, ALL_SQUARES, -BISHOP_VALUE},
+	{WHITE, ROOK, ALL_SQUARES, ROOK_VALUE}, {BLACK, ROOK, ALL_SQUARES, -ROOK_VALUE},
+	{WHITE, QUEEN, ALL_SQUARES, QUEEN_VALUE}, {BLACK, QUEEN, ALL_SQUARES, -QUEEN_VALUE},
+	{WHITE, KING, ALL_SQUARES, KING_VALUE}, {BLACK, KING, ALL_SQUARES, -KING_VALUE},
+	// Knights: bonus for centralized and developed knights, penalty in the corners and on the rim
+	{WHITE, KNIGHT, CENTRAL_SQUARES, CENTRAL_KNIGHT_BONUS}, {BLACK, KNIGHT, CENTRAL_SQUARES, -CENTRAL_KNIGHT_BONUS},
+	{WHITE, KNIGHT, WHITE_DEVELOPED_SQUARES, DEVELOPED_KNIGHT_BONUS}, {BLACK, KNIGHT, BLACK_DEVELOPED_SQUARES, -DEVELOPED_KNIGHT_BONUS},
+	{WHITE, KNIGHT, CORNER_SQUARES, -CORNER_KNIGHT_PENALTY}, {BLACK, KNIGHT, CORNER_SQUARES, CORNER_KNIGHT_PENALTY},
+	{WHITE, KNIGHT, RIM_SQUARES, -RIM_KNIGHT_PENALTY}, {BLACK, KNIGHT, RIM_SQUARES, RIM_KNIGHT_PENALTY},
+	// Pawns on advanced rows
+	{WHITE, PAWN, WHITE_PAWN_ADVANCED_ROWS, PAWN_ADVANCED_BONUS}, {BLACK, PAWN, BLACK_PAWN_ADVANCED_ROWS, -PAWN_ADVANCED_BONUS},
+};
+
+// Portable kernel
+static int evaluate_terms_generic(const Board *board) {
 	int score = 0;
+	for (int i = 0; i < EVAL_TERMS; i++) {
+		const EvalTerm *t = &evalTerms[i];
+		score += t->weight * __builtin_popcountll(board->bb[t->color][t->piece] & t->mask);
+	}
+	return score;
+}
+
+#if defined(__x86_64__)
+// AVX2 kernel: four terms per step. AVX2 has no vector popcount, so bytes are
+// counted with a nibble lookup (vpshufb) and summed per lane with vpsadbw.
+__attribute__((target("avx2"))) static int evaluate_terms_avx2(const Board *board) {
+	const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+	__m256i sum = _mm256_setzero_si256();
+
+	for (int i = 0; i < EVAL_TERMS; i += 4) {
+		const EvalTerm *t = &evalTerms[i];
+		__m256i bitboards = _mm256_set_epi64x(board->bb[t[3].color][t[3].piece], board->bb[t[2].color][t[2].piece], board->bb[t[1].color][t[1].piece],
+											  board->bb[t[0].color][t[0].piece]);
+		__m256i masks = _mm256_set_epi64x(t[3].mask, t[2].mask, t[1].mask, t[0].mask);
+		__m256i weights = _mm256_set_epi64x(t[3].weight, t[2].weight, t[1].weight, t[0].weight);
+
+		__m256i bits = _mm256_and_si256(bitboards, masks);
+		__m256i low = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(bits, lowNibbles));
+		__m256i high = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi64(bits, 4), lowNibbles));
+		__m256i counts = _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256());
+		// Counts and weights fit in 32 bits, so the signed 32x32->64 multiply is exact
+		sum = _mm256_add_epi64(sum, _mm256_mul_epi32(counts, weights));
+	}
 
+	__m128i pair = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	return (int)(_mm_cvtsi128_si64(pair) + _mm_extract_epi64(pair, 1));
+}
+#endif
 
-	// Apply bonus for pawns on advanced rows
-	score += PAWN_ADVANCED_BONUS * __builtin_popcountll(board->pawns[WHITE] & WHITE_PAWN_ADVANCED_ROWS);
-	score -= PAWN_ADVANCED_BONUS * __builtin_popcountll(board->pawns[BLACK] & BLACK_PAWN_ADVANCED_ROWS);
+// Picked by init_evaluate
+static int (*evaluate_terms)(const Board *board) = evaluate_terms_generic;
 
-	return score;
+void init_evaluate() {
+#if defined(__x86_64__)
+	if (cpuFeatures.avx2) {
+		evaluate_terms = evaluate_terms_avx2;
+	}
+#endif
 }
+
 #define BISHOP_OPENING_SQUARES_PENALTY 20
 #define WHITE_BISHOP_OPENING_SQUARES 0x0000000000000042ULL // c1, f1 squares
 #define BLACK_BISHOP_OPENING_SQUARES 0x4200000000000000ULL // c8, f8 squares
 int evaluate_bishop_position(Board *board) {
     int score = 0;
 
-    uint64_t whiteBishops = board->bishops[WHITE];
-    uint64_t blackBishops = board->bishops[BLACK];
+    uint64_t whiteBishops = board->bb[WHITE][BISHOP];
+    uint64_t blackBishops = board->bb[BLACK][BISHOP];
 
     // Apply penalty for bishops on their opening squares
     score -= BISHOP_OPENING_SQUARES_PENALTY * __builtin_popcountll(whiteBishops & WHITE_BISHOP_OPENING_SQUARES);
@@ -93,17 +126,12 @@ int evaluate_bishop_position(Board *board) {
 int evaluate(Board *board) {
 	int score = 0;
 
-	// Evaluate material balance
-	score += evaluate_material(board);
-
-	// Evaluate positional bonuses for knights
-	score += evaluate_knight_position(board);
+	// Material, knight and pawn placement
+	score += evaluate_terms(board);
 
     // Evaluate positional penalties for bishops
     // score += evaluate_bishop_position(board);
 
-	score += evaluate_pawn_position(board);
-
 	// If it's black's turn, negate the score
 	if (board->sideToMove == BLACK) {
 		score = -score;
@@ -125,19 +153,19 @@ int position_penalty(const Board *board, int side) {
     int adjustment = 0;
     if (side == BLACK) {
         adjustment = BISHOP_KNIGHT_START_PENALTY * (
-            __builtin_popcountll(board->bishops[WHITE] & WHITE_BISHOP_START_SQUARES) +
-            __builtin_popcountll(board->knights[WHITE] & WHITE_KNIGHT_START_SQUARES)
+            __builtin_popcountll(board->bb[WHITE][BISHOP] & WHITE_BISHOP_START_SQUARES) +
+            __builtin_popcountll(board->bb[WHITE][KNIGHT] & WHITE_KNIGHT_START_SQUARES)
         );
-        if ((board->pawns[WHITE] & WHITE_CENTRAL_PAWNS_START) == WHITE_CENTRAL_PAWNS_START) {
+        if ((board->bb[WHITE][PAWN] & WHITE_CENTRAL_PAWNS_START) == WHITE_CENTRAL_PAWNS_START) {
 			adjustment += CENTRAL_PAWN_PENALTY;
 		}
     } else {
         adjustment = BISHOP_KNIGHT_START_PENALTY * (
-            __builtin_popcountll(board->bishops[BLACK] & BLACK_BISHOP_START_SQUARES) +
-            __builtin_popcountll(board->knights[BLACK] & BLACK_KNIGHT_START_SQUARES)
+            __builtin_popcountll(board->bb[BLACK][BISHOP] & BLACK_BISHOP_START_SQUARES) +
+            __builtin_popcountll(board->bb[BLACK][KNIGHT] & BLACK_KNIGHT_START_SQUARES)
         );
 
-		if ((board->pawns[BLACK] & BLACK_CENTRAL_PAWNS_START) == BLACK_CENTRAL_PAWNS_START) {
+		if ((board->bb[BLACK][PAWN] & BLACK_CENTRAL_PAWNS_START) == BLACK_CENTRAL_PAWNS_START) {
 			adjustment += CENTRAL_PAWN_PENALTY;
 		}
     }
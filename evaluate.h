@@ -3,6 +3,10 @@
 
 #include "board.h"
 
+extern const int pieceValues[7];
+
+// Pick the evaluation kernel for this CPU, call once at startup after init_cpu
+void init_evaluate();
 int evaluate(Board *board);
 int position_penalty(const Board *board, int side);
 
@@ -1,27 +1,18 @@
 #include <stdio.h>
+#include <string.h>
 #include "game.h"
 #include "board.h"
 
-// Define the piece characters
-const char emptySquare = '.';
-const char whitePawns = 'P';
-const char whiteKnights = 'N';
-const char whiteBishops = 'B';
-const char whiteRooks = 'R';
-const char whiteQueens = 'Q';
-const char whiteKing = 'K';
-const char blackPawns = 'p';
-const char blackKnights = 'n';
-const char blackBishops = 'b';
-const char blackRooks = 'r';
-const char blackQueens = 'q';
-const char blackKing = 'k';
+// Define the piece characters, indexed by [color][piece type]
+const char *pieceCharacters[2] = {".PNBRQK", ".pnbrqk"};
 
 void game_newGame(Game *game) {
 	// Initialize a new board for the new game
 	initializeBoard(&game->board);
 	// Initialize other game state variables as needed
 	game->positionHistoryLength = 0;
+	game->positionHistory[game->positionHistoryLength] = game->board.zobristKey;
+	game->positionHistoryLength++;
 }
 
 void game_setFEN(Game *game, const char *fen) {
@@ -34,16 +25,54 @@ void game_setFEN(Game *game, const char *fen) {
 	game->positionHistoryLength++;
 }
 
+// A move of the game itself. Past MAX_POSITION_HISTORY the history starts over from the
+// current position, so the game never eats into the room the search needs on top of it.
+void game_play_move(Game *game, Move move) {
+	if (game->positionHistoryLength >= MAX_POSITION_HISTORY) {
+		game->positionHistory[0] = game->board.zobristKey;
+		game->positionHistoryLength = 1;
+	}
+	game_make_move(game, move);
+}
+
+// Every move is pushed: the game stays under MAX_POSITION_HISTORY and a search line under MAX_PLY
 void game_make_move(Game *game, Move move) {
-	make_move(&game->board, move);
+	make_move(&game->board, move, &game->undoStack[game->positionHistoryLength]);
+	game->positionHistory[game->positionHistoryLength] = game->board.zobristKey;
+	game->positionHistoryLength++;
+}
 
-	if (game->positionHistoryLength < MAX_POSITION_HISTORY) {
-		game->positionHistory[game->positionHistoryLength] = game->board.zobristKey;
-		game->positionHistoryLength++;
-	} else {
-		// Handle the case where positionHistory is full - you might want to
-		// simply stop the game at this point
+// Null move for the search: the passed position still goes on the history
+void game_make_null_move(Game *game) {
+	make_null_move(&game->board, &game->undoStack[game->positionHistoryLength]);
+	game->positionHistory[game->positionHistoryLength] = game->board.zobristKey;
+	game->positionHistoryLength++;
+}
+
+void game_unmake_null_move(Game *game) {
+	if (game->positionHistoryLength <= 1) {
+		return;
+	}
+	game->positionHistoryLength--;
+	unmake_null_move(&game->board, &game->undoStack[game->positionHistoryLength]);
+}
+
+// Copy only the used part of the history, a full Game is mostly empty stacks
+void game_copy(Game *dst, const Game *src) {
+	dst->board = src->board;
+	dst->positionHistoryLength = src->positionHistoryLength;
+	memcpy(dst->positionHistory, src->positionHistory, src->positionHistoryLength * sizeof(uint64_t));
+	memcpy(dst->undoStack, src->undoStack, src->positionHistoryLength * sizeof(Undo));
+}
+
+// Takes back the last move made with game_make_move. The first entry is the starting
+// position, no move led to it.
+void game_unmake_move(Game *game) {
+	if (game->positionHistoryLength <= 1) {
+		return;
 	}
+	game->positionHistoryLength--;
+	unmake_move(&game->board, &game->undoStack[game->positionHistoryLength]);
 }
 
 void print_bitboard(uint64_t bb) {
@@ -62,19 +91,8 @@ void printBoard(const Board *board) {
 	for (int rank = BOARD_SIZE - 1; rank >= 0; --rank) {
 		for (int file = 0; file < BOARD_SIZE; ++file) {
 			int square = rank * BOARD_SIZE + file;
-			int pieceType = (board->pawns[WHITE] >> square) & 1		? whitePawns
-							: (board->knights[WHITE] >> square) & 1 ? whiteKnights
-							: (board->bishops[WHITE] >> square) & 1 ? whiteBishops
-							: (board->rooks[WHITE] >> square) & 1	? whiteRooks
-							: (board->queens[WHITE] >> square) & 1	? whiteQueens
-							: (board->kings[WHITE] >> square) & 1	? whiteKing
-							: (board->pawns[BLACK] >> square) & 1	? blackPawns
-							: (board->knights[BLACK] >> square) & 1 ? blackKnights
-							: (board->bishops[BLACK] >> square) & 1 ? blackBishops
-							: (board->rooks[BLACK] >> square) & 1	? blackRooks
-							: (board->queens[BLACK] >> square) & 1	? blackQueens
-							: (board->kings[BLACK] >> square) & 1	? blackKing
-																	: emptySquare;
+			int color = (board->bb[BLACK][ALL_PIECES] >> square) & 1;
+			char pieceType = pieceCharacters[color][board->squares[square]];
 
 			// Print the piece character
 			printf("%c ", pieceType);
@@ -5,17 +5,25 @@
 #include "move.h"
 
 #define MAX_POSITION_HISTORY 1000 // This can be adjusted as needed
+// Deepest line the search plays on top of the game; the stacks keep room for it
+#define MAX_PLY 128
 
 typedef struct {
   Board board;
-  uint64_t positionHistory[MAX_POSITION_HISTORY]; // Add this line
-  int positionHistoryLength;                      // And this line
+  uint64_t positionHistory[MAX_POSITION_HISTORY + MAX_PLY]; // Add this line
+  int positionHistoryLength;                                // And this line
+  Undo undoStack[MAX_POSITION_HISTORY + MAX_PLY];           // undoStack[i] takes back the move that led to positionHistory[i]
   // Add other game state variables as needed
 } Game;
 
 void game_newGame(Game *game);
 void game_setFEN(Game *game, const char *fen);
+void game_play_move(Game *game, Move move);
 void game_make_move(Game *game, Move move);
+void game_unmake_move(Game *game);
+void game_make_null_move(Game *game);
+void game_unmake_null_move(Game *game);
+void game_copy(Game *dst, const Game *src);
 void printGame(const Game *game);
 void printBoard(const Board *board);
 void print_bitboard(uint64_t bb);
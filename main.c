@@ -1,6 +1,14 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "bench.h"
+#include "bitboard.h"
+#include "cpu.h"
+#include "evaluate.h"
 #include "game.h"
 #include "perft.h"
+#include "search.h"
+#include "tt.h"
 #include "uci.h"
 #include "zobrist.h"
 
@@ -21,14 +29,29 @@ int main(int argc, char *argv[]) {
 	Game game;
 
 	// At the start of your engine
+	init_cpu();
 	init_zobrist();
+	init_bitboards();
+	init_evaluate();
+	init_search();
+	tt_resize(TT_DEFAULT_MB);
 
 	game_newGame(&game);
 
 	if (argc > 1) {
 		// The second argument is argv[1], argv[0] is the program name itself
+		// chessgpt perft [depth] [hash MB]
 		if (strcmp(argv[1], "perft") == 0) {
-			performPerft(&game, 6);
+			int depth = argc > 2 ? atoi(argv[2]) : 6;
+			if (argc > 3) {
+				perft_set_hash((size_t)atoi(argv[3]));
+			}
+			printf("%lu\n", performPerft(&game, depth));
+			return 0;
+		}
+		// chessgpt bench [depth]
+		if (strcmp(argv[1], "bench") == 0) {
+			bench(argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_DEPTH);
 			return 0;
 		}
 	}
@@ -0,0 +1,254 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "attacked.h"
+#include "bench.h"
+#include "bitboard.h"
+#include "board.h"
+#include "cpu.h"
+#include "evaluate.h"
+#include "move.h"
+#include "zobrist.h"
+
+// Times the hot kernels one at a time over a fixed corpus of positions.
+// make microbench && ./microbench [-c cpu] [-r repetitions] [kernel ...]
+
+#define WALKS_PER_SEED 16
+#define WALK_PLIES 32
+#define SAMPLE_EVERY 4
+#define MAX_CORPUS 4096
+
+#define WARMUP_REPS 3
+#define DEFAULT_REPS 10
+#define MIN_REP_NS 20000000.0 // each repetition runs whole passes for at least 20ms
+
+static Board corpus[MAX_CORPUS];
+static int corpusSize;
+
+// Legal moves of every corpus position, flattened; position i owns moves[moveStart[i] .. moveStart[i + 1])
+static Move *corpusMoves;
+static int moveStart[MAX_CORPUS + 1];
+
+// Kernel results are summed here so the compiler can't drop the calls
+static volatile uint64_t sink;
+
+// xorshift64*, fixed seed so every run times the same corpus
+static uint64_t walkSeed = 0x2545F4914F6CDD1DULL;
+static uint64_t random_uint64() {
+	walkSeed ^= walkSeed >> 12;
+	walkSeed ^= walkSeed << 25;
+	walkSeed ^= walkSeed >> 27;
+	return walkSeed * 0x2545F4914F6CDD1DULL;
+}
+
+// The bench positions plus positions sampled along random games played from them
+static void build_corpus() {
+	for (int seed = 0; seed < benchPositionCount; seed++) {
+		Board start;
+		setBoardtoFEN(&start, benchPositions[seed]);
+		corpus[corpusSize++] = start;
+
+		for (int walk = 0; walk < WALKS_PER_SEED; walk++) {
+			Board board = start;
+			for (int ply = 1; ply <= WALK_PLIES && corpusSize < MAX_CORPUS; ply++) {
+				Move moves[MAX_MOVES];
+				int count = generateMoves(&board, moves);
+				if (count == 0) {
+					break;
+				}
+				Undo undo;
+				make_move(&board, moves[random_uint64() % count], &undo);
+				if (ply % SAMPLE_EVERY == 0) {
+					corpus[corpusSize++] = board;
+				}
+			}
+		}
+	}
+
+	corpusMoves = malloc(sizeof(Move) * MAX_MOVES * corpusSize);
+	for (int i = 0; i < corpusSize; i++) {
+		moveStart[i + 1] = moveStart[i] + generateMoves(&corpus[i], corpusMoves + moveStart[i]);
+	}
+}
+
+// Each kernel makes one pass over the corpus and returns its op count for that pass
+
+static uint64_t kernel_generate_moves() {
+	Move moves[MAX_MOVES];
+	uint64_t total = 0;
+	for (int i = 0; i < corpusSize; i++) {
+		total += generateMoves(&corpus[i], moves);
+	}
+	sink += total;
+	return corpusSize;
+}
+
+// One op is a make_move and its unmake_move
+static uint64_t kernel_make_move() {
+	uint64_t keys = 0;
+	for (int i = 0; i < corpusSize; i++) {
+		for (int m = moveStart[i]; m < moveStart[i + 1]; m++) {
+			Undo undo;
+			make_move(&corpus[i], corpusMoves[m], &undo);
+			keys ^= corpus[i].zobristKey;
+			unmake_move(&corpus[i], &undo);
+		}
+	}
+	sink += keys;
+	return moveStart[corpusSize];
+}
+
+// One op is one square of one position
+static uint64_t kernel_is_square_attacked() {
+	uint64_t attacked = 0;
+	for (int i = 0; i < corpusSize; i++) {
+		for (int square = 0; square < 64; square++) {
+			attacked += is_square_attacked(&corpus[i], square);
+		}
+	}
+	sink += attacked;
+	return (uint64_t)corpusSize * 64;
+}
+
+static uint64_t kernel_evaluate() {
+	int64_t total = 0;
+	for (int i = 0; i < corpusSize; i++) {
+		total += evaluate(&corpus[i]);
+	}
+	sink += total;
+	return corpusSize;
+}
+
+static uint64_t kernel_compute_zobrist_key() {
+	uint64_t keys = 0;
+	for (int i = 0; i < corpusSize; i++) {
+		keys ^= compute_zobrist_key(&corpus[i]);
+	}
+	sink += keys;
+	return corpusSize;
+}
+
+typedef struct {
+  const char *name;
+  uint64_t (*run)();
+} Kernel;
+
+static const Kernel kernels[] = {
+	{"generateMoves", kernel_generate_moves},
+	{"make_move", kernel_make_move},
+	{"is_square_attacked", kernel_is_square_attacked},
+	{"evaluate", kernel_evaluate},
+	{"compute_zobrist_key", kernel_compute_zobrist_key},
+};
+
+#define KERNELS (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Run passes corpus passes, return ns per op
+static double time_passes(const Kernel *kernel, int passes) {
+	uint64_t ops = 0;
+	double start = now_ns();
+	for (int p = 0; p < passes; p++) {
+		ops += kernel->run();
+	}
+	return (now_ns() - start) / ops;
+}
+
+static void measure(const Kernel *kernel, int reps) {
+	// Warmup doubles as calibration: find how many passes fill MIN_REP_NS
+	int passes = 1;
+	for (int w = 0; w < WARMUP_REPS; w++) {
+		double start = now_ns();
+		time_passes(kernel, passes);
+		double elapsed = now_ns() - start;
+		if (elapsed < MIN_REP_NS) {
+			passes = (int)(passes * MIN_REP_NS / (elapsed > 1 ? elapsed : 1)) + 1;
+		}
+	}
+
+	double sum = 0, sumSquares = 0, best = INFINITY;
+	for (int r = 0; r < reps; r++) {
+		double nsPerOp = time_passes(kernel, passes);
+		sum += nsPerOp;
+		sumSquares += nsPerOp * nsPerOp;
+		if (nsPerOp < best) {
+			best = nsPerOp;
+		}
+	}
+	double mean = sum / reps;
+	double variance = reps > 1 ? (sumSquares - sum * mean) / (reps - 1) : 0;
+	if (variance < 0) {
+		variance = 0;
+	}
+
+	printf("%-20s %10.2f %10.2f %9.2f %7.2f%% %14.0f\n", kernel->name, mean, best, sqrt(variance), 100 * sqrt(variance) / mean, 1e9 / mean);
+}
+
+// Keep the scheduler from moving us between cores mid-measurement
+static void pin_to_cpu(int cpu) {
+	if (cpu < 0) {
+		cpu = sched_getcpu();
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		printf("could not pin to cpu %d, timings may be noisier\n", cpu);
+		return;
+	}
+	printf("pinned to cpu %d\n", cpu);
+}
+
+int main(int argc, char *argv[]) {
+	int cpu = -1;
+	int reps = DEFAULT_REPS;
+	int first = 1;
+	while (first < argc && argv[first][0] == '-') {
+		if (strcmp(argv[first], "-c") == 0 && first + 1 < argc) {
+			cpu = atoi(argv[first + 1]);
+		} else if (strcmp(argv[first], "-r") == 0 && first + 1 < argc) {
+			reps = atoi(argv[first + 1]);
+		} else {
+			printf("usage: %s [-c cpu] [-r repetitions] [kernel ...]\n", argv[0]);
+			return 1;
+		}
+		first += 2;
+	}
+	if (reps < 1) {
+		reps = 1;
+	}
+
+	init_cpu();
+	init_zobrist();
+	init_bitboards();
+	init_evaluate();
+
+	pin_to_cpu(cpu);
+	build_corpus();
+	printf("cpu path: %s\n", cpu_path_name());
+	printf("corpus: %d positions, %d moves; %d warmup + %d timed repetitions per kernel\n\n", corpusSize, moveStart[corpusSize], WARMUP_REPS, reps);
+	printf("%-20s %10s %10s %9s %8s %14s\n", "kernel", "ns/op", "best", "stddev", "rel", "ops/sec");
+
+	for (int k = 0; k < KERNELS; k++) {
+		// With names on the command line, only run those
+		int selected = first == argc;
+		for (int a = first; a < argc; a++) {
+			selected |= strcmp(argv[a], kernels[k].name) == 0;
+		}
+		if (selected) {
+			measure(&kernels[k], reps);
+		}
+	}
+
+	free(corpusMoves);
+	return 0;
+}
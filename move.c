@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include "move.h"
 #include "attacked.h"
+#include "bitboard.h"
 #include "board.h"
 #include "game.h"
 #include "zobrist.h"
@@ -11,16 +12,14 @@ Decoding a move:
 int from = FROM_SQUARE(move);
 int to = TO_SQUARE(move);
 int promotedPiece = PROMOTED_PIECE(move);
-int capturedPiece = CAPTURED_PIECE(move);
+int capturedPiece = capturedPieceOf(board, move);
 int enPassant = IS_EN_PASSANT(move);
 int castling = IS_CASTLING(move);
-int doublePawnMove = IS_DOUBLE_PAWN_MOVE(move);
-int score = MOVE_SCORE(move);
 
 Encoding a move:
-Move m = CREATE_MOVE(fromSquare, toSquare, promotedPiece, capturedPiece,
-enPassantFlag, castlingFlag, doublePawnMoveFlag, moveScore);
-
+Move m = CREATE_MOVE(fromSquare, toSquare);
+Move m = CREATE_PROMOTION(fromSquare, toSquare, promotedPiece);
+Move m = CREATE_SPECIAL_MOVE(fromSquare, toSquare, MOVE_EN_PASSANT or MOVE_CASTLING);
 
 */
 
@@ -37,102 +36,58 @@ enPassantFlag, castlingFlag, doublePawnMoveFlag, moveScore);
 #define KINGSIDE_CASTLING 0	 // Assuming the first bit in the castling rights bit field represents kingside castling
 #define QUEENSIDE_CASTLING 1 // Assuming the second bit in the castling rights bit field represents  queenside castling
 
-int getPieceType(Board *board, int square) {
-	uint64_t mask = 1ULL << square;
-	if (board->pawns[board->sideToMove] & mask)
-		return PAWN;
-	if (board->knights[board->sideToMove] & mask)
-		return KNIGHT;
-	if (board->bishops[board->sideToMove] & mask)
-		return BISHOP;
-	if (board->rooks[board->sideToMove] & mask)
-		return ROOK;
-	if (board->queens[board->sideToMove] & mask)
-		return QUEEN;
-	if (board->kings[board->sideToMove] & mask)
-		return KING;
-	return EMPTY;
-}
-
-void removePiece(Board *board, int pieceType, int side, uint64_t mask) {
-	switch (pieceType) {
-	case PAWN:
-		board->pawns[side] &= ~mask;
-		break;
-	case KNIGHT:
-		board->knights[side] &= ~mask;
-		break;
-	case BISHOP:
-		board->bishops[side] &= ~mask;
-		break;
-	case ROOK:
-		board->rooks[side] &= ~mask;
-		break;
-	case QUEEN:
-		board->queens[side] &= ~mask;
-		break;
-	case KING:
-		board->kings[side] &= ~mask;
-		break;
-	}
-	board->occupied[side] &= ~mask;
-}
-
-void placePiece(Board *board, int pieceType, int side, uint64_t mask) {
-	switch (pieceType) {
-	case PAWN:
-		board->pawns[side] |= mask;
-		break;
-	case KNIGHT:
-		board->knights[side] |= mask;
-		break;
-	case BISHOP:
-		board->bishops[side] |= mask;
-		break;
-	case ROOK:
-		board->rooks[side] |= mask;
-		break;
-	case QUEEN:
-		board->queens[side] |= mask;
-		break;
-	case KING:
-		board->kings[side] |= mask;
-		break;
-	}
-	board->occupied[side] |= mask;
-}
-
-
-extern uint64_t zobrist_piece_keys[6][2][64];
+extern uint64_t zobrist_piece_keys[7][2][64];
 extern uint64_t zobrist_side_key;
 extern uint64_t zobrist_castling_keys[2][2];
 extern uint64_t zobrist_ep_keys[8]; // 8 possible files for en passant
 
-void make_move(Board *board, Move move) {
+// Material key term for the count of side's pieces of this type. XORed in when a piece
+// is added with the count before it and out when one is removed with the count after it.
+static inline uint64_t materialKeyAt(const Board *board, int side, int piece) {
+	return zobrist_piece_keys[piece][side][__builtin_popcountll(board->bb[side][piece])];
+}
+
+// Makes the move in place, recording in undo what unmake_move needs to take it back.
+// side is always a constant: make_move_white/make_move_black inline this once per color,
+// which folds every side == WHITE test below.
+static inline __attribute__((always_inline)) void make_move_side(Board *board, Move move, Undo *undo, const int side) {
 	// Get all move properties
 	int from = FROM_SQUARE(move);
 	int to = TO_SQUARE(move);
 	int promotedPiece = PROMOTED_PIECE(move);
-	int capturedPiece = CAPTURED_PIECE(move);
+	int capturedPiece = capturedPieceOf(board, move);
 	int enPassant = IS_EN_PASSANT(move);
 	int castling = IS_CASTLING(move);
-	int doublePawnMove = IS_DOUBLE_PAWN_MOVE(move);
-	// int score = MOVE_SCORE(move);
 
 	// Assuming only pawns can promote for simplicity
-	int pieceType = (promotedPiece != EMPTY) ? PAWN : getPieceType(board, from);
-	int side = board->sideToMove;
-	uint64_t fromMask = 1ULL << from;
-	uint64_t toMask = 1ULL << to;
+	int pieceType = board->squares[from];
+	int doublePawnMove = pieceType == PAWN && (from ^ to) == 16;
+
+	undo->move = move;
+	undo->movedPiece = pieceType;
+	undo->capturedPiece = capturedPiece;
+	undo->castleRights[WHITE] = board->castleRights[WHITE];
+	undo->castleRights[BLACK] = board->castleRights[BLACK];
+	undo->enPassantSquare = board->enPassantSquare;
+	undo->zobristKey = board->zobristKey;
+	undo->pawnKey = board->pawnKey;
+	undo->materialKey = board->materialKey;
 
 	// Remove piece from the 'from' square
-	removePiece(board, pieceType, side, fromMask);
+	removePiece(board, side, pieceType, from);
 	board->zobristKey ^= zobrist_piece_keys[pieceType][side][from]; // update Zobrist key
+	if (pieceType == PAWN) {
+		board->pawnKey ^= zobrist_piece_keys[PAWN][side][from];
+	}
 
 	// If a piece was captured, remove it from the 'to' square
 	if (capturedPiece != EMPTY && !enPassant) {
-		removePiece(board, capturedPiece, side ^ 1, toMask);
+		removePiece(board, side ^ 1, capturedPiece, to);
 		board->zobristKey ^= zobrist_piece_keys[capturedPiece][side ^ 1][to]; // update Zobrist key
+		board->materialKey ^= materialKeyAt(board, side ^ 1, capturedPiece);
+		if (capturedPiece == PAWN) {
+			board->pawnKey ^= zobrist_piece_keys[PAWN][side ^ 1][to];
+		}
 
 		// If a rook was captured, update the castling rights
 		if (capturedPiece == ROOK) {
@@ -151,7 +106,13 @@ void make_move(Board *board, Move move) {
 	}
 
 	// Place piece (or promoted piece if applicable) to the 'to' square
-	placePiece(board, promotedPiece != EMPTY ? promotedPiece : pieceType, side, toMask);
+	if (promotedPiece != EMPTY) {
+		// One pawn fewer, one more of the new piece
+		board->materialKey ^= materialKeyAt(board, side, PAWN) ^ materialKeyAt(board, side, promotedPiece);
+	} else if (pieceType == PAWN) {
+		board->pawnKey ^= zobrist_piece_keys[PAWN][side][to];
+	}
+	placePiece(board, side, promotedPiece != EMPTY ? promotedPiece : pieceType, to);
 	board->zobristKey ^= zobrist_piece_keys[promotedPiece != EMPTY ? promotedPiece : pieceType][side][to]; // update Zobrist key
 
 	// If a rook is moved from its original position, update the castling rights
@@ -183,8 +144,10 @@ void make_move(Board *board, Move move) {
 		}
 	}
 
-	// If a pawn moved two squares forward, set the en passant square
-	if (doublePawnMove) {
+	// If a pawn moved two squares forward, set the en passant square, but only when an
+	// enemy pawn can capture there, so positions that differ only by a dead en passant
+	// square share a zobrist key
+	if (doublePawnMove && (pawnAttacks[side][side == WHITE ? from + 8 : from - 8] & board->bb[side ^ 1][PAWN])) {
 		int oldEnPassantFile = board->enPassantSquare >= 0 ? board->enPassantSquare % 8 : -1;
 		if (oldEnPassantFile >= 0) {
 			board->zobristKey ^= zobrist_ep_keys[oldEnPassantFile]; // update Zobrist key if there was an en passant target square before
@@ -202,30 +165,27 @@ void make_move(Board *board, Move move) {
 	// Handle en passant
 	if (enPassant) {
 		int enPassantCaptureSquare = (side == WHITE ? to - 8 : to + 8);
-		uint64_t enPassantMask = 1ULL << enPassantCaptureSquare;
-		removePiece(board, PAWN, side ^ 1, enPassantMask);
+		removePiece(board, side ^ 1, PAWN, enPassantCaptureSquare);
 		// Update Zobrist key for en passant capture
 		board->zobristKey ^= zobrist_piece_keys[PAWN][side ^ 1][enPassantCaptureSquare];
+		board->pawnKey ^= zobrist_piece_keys[PAWN][side ^ 1][enPassantCaptureSquare];
+		board->materialKey ^= materialKeyAt(board, side ^ 1, PAWN);
 	}
 
 	// Handle castling
 	if (castling) {
 		// Determine whether it's kingside or queenside castling based on the to and from squares
+		int rookFrom, rookTo;
 		if (to - from > 1) { // Kingside castling
-			// Remove the rook from its original square
-			uint64_t kingsideRookMask = 1ULL << (side == WHITE ? H1 : H8);
-			removePiece(board, ROOK, side, kingsideRookMask);
-			// Place the rook next to the king
-			uint64_t newRookMask = 1ULL << (side == WHITE ? F1 : F8);
-			placePiece(board, ROOK, side, newRookMask);
+			rookFrom = side == WHITE ? H1 : H8;
+			rookTo = side == WHITE ? F1 : F8;
 		} else { // Queenside castling
-			// Remove the rook from its original square
-			uint64_t queensideRookMask = 1ULL << (side == WHITE ? A1 : A8);
-			removePiece(board, ROOK, side, queensideRookMask);
-			// Place the rook next to the king
-			uint64_t newRookMask = 1ULL << (side == WHITE ? D1 : D8);
-			placePiece(board, ROOK, side, newRookMask);
+			rookFrom = side == WHITE ? A1 : A8;
+			rookTo = side == WHITE ? D1 : D8;
 		}
+		// Move the rook from its original square to next to the king
+		movePiece(board, side, ROOK, rookFrom, rookTo);
+		board->zobristKey ^= zobrist_piece_keys[ROOK][side][rookFrom] ^ zobrist_piece_keys[ROOK][side][rookTo]; // update Zobrist key
 		// After castling, update castling rights - turn off both castling bits
 		if (board->castleRights[side] & (1 << KINGSIDE_CASTLING)) {				 // Check if kingside castling is currently allowed
 			board->castleRights[side] &= ~(1 << KINGSIDE_CASTLING);				 // Turn off kingside castling bit  update Zobrist key
@@ -238,13 +198,104 @@ void make_move(Board *board, Move move) {
 	}
 
 	// Switch the side to move
-	board->sideToMove ^= 1;
+	board->sideToMove = side ^ 1;
 	board->zobristKey ^= zobrist_side_key; // update Zobrist key
 }
 
-int generateMoves(Board *board, Move *moves) {
-	const int knightRankOffsets[8] = {-2, -1, 1, 2, 2, 1, -1, -2};
-	const int knightFileOffsets[8] = {1, 2, 2, 1, -1, -2, -2, -1};
+static void make_move_white(Board *board, Move move, Undo *undo) {
+	make_move_side(board, move, undo, WHITE);
+}
+
+static void make_move_black(Board *board, Move move, Undo *undo) {
+	make_move_side(board, move, undo, BLACK);
+}
+
+// Two-entry dispatch on the side to move
+static void (*const makeMoveBySide[2])(Board *board, Move move, Undo *undo) = {make_move_white, make_move_black};
+
+void make_move(Board *board, Move move, Undo *undo) {
+	makeMoveBySide[board->sideToMove](board, move, undo);
+}
+
+// Takes back the move recorded in undo, which must be the last move made on the board.
+// side is the color that made the move, a constant as in make_move_side.
+static inline __attribute__((always_inline)) void unmake_move_side(Board *board, const Undo *undo, const int side) {
+	Move move = undo->move;
+	int from = FROM_SQUARE(move);
+	int to = TO_SQUARE(move);
+	int promotedPiece = PROMOTED_PIECE(move);
+
+	// Back to the side that made the move
+	board->sideToMove = side;
+
+	// Move the piece back, turning a promoted piece back into a pawn
+	removePiece(board, side, promotedPiece != EMPTY ? promotedPiece : undo->movedPiece, to);
+	placePiece(board, side, undo->movedPiece, from);
+
+	// Put back a captured piece
+	if (IS_EN_PASSANT(move)) {
+		placePiece(board, side ^ 1, PAWN, side == WHITE ? to - 8 : to + 8);
+	} else if (undo->capturedPiece != EMPTY) {
+		placePiece(board, side ^ 1, undo->capturedPiece, to);
+	}
+
+	// Put back the rook of a castling move
+	if (IS_CASTLING(move)) {
+		if (to - from > 1) { // Kingside castling
+			movePiece(board, side, ROOK, side == WHITE ? F1 : F8, side == WHITE ? H1 : H8);
+		} else { // Queenside castling
+			movePiece(board, side, ROOK, side == WHITE ? D1 : D8, side == WHITE ? A1 : A8);
+		}
+	}
+
+	board->castleRights[WHITE] = undo->castleRights[WHITE];
+	board->castleRights[BLACK] = undo->castleRights[BLACK];
+	board->enPassantSquare = undo->enPassantSquare;
+	board->zobristKey = undo->zobristKey;
+	board->pawnKey = undo->pawnKey;
+	board->materialKey = undo->materialKey;
+}
+
+static void unmake_move_white(Board *board, const Undo *undo) {
+	unmake_move_side(board, undo, WHITE);
+}
+
+static void unmake_move_black(Board *board, const Undo *undo) {
+	unmake_move_side(board, undo, BLACK);
+}
+
+static void (*const unmakeMoveBySide[2])(Board *board, const Undo *undo) = {unmake_move_white, unmake_move_black};
+
+void unmake_move(Board *board, const Undo *undo) {
+	// The side that made the move is the one not to move now
+	unmakeMoveBySide[board->sideToMove ^ 1](board, undo);
+}
+
+// Pass the turn without moving, for null-move pruning; undo->move is 0
+void make_null_move(Board *board, Undo *undo) {
+	undo->move = 0;
+	undo->movedPiece = EMPTY;
+	undo->capturedPiece = EMPTY;
+	undo->enPassantSquare = board->enPassantSquare;
+	undo->zobristKey = board->zobristKey;
+
+	if (board->enPassantSquare >= 0) {
+		board->zobristKey ^= zobrist_ep_keys[board->enPassantSquare % 8];
+		board->enPassantSquare = -1;
+	}
+	board->zobristKey ^= zobrist_side_key;
+	board->sideToMove ^= 1;
+}
+
+void unmake_null_move(Board *board, const Undo *undo) {
+	board->sideToMove ^= 1;
+	board->enPassantSquare = undo->enPassantSquare;
+	board->zobristKey = undo->zobristKey;
+}
+
+// Reference generator: pseudo-legal moves filtered by making each one on a copy
+// and testing the king. Slow; kept to cross-check generateMoves in debug builds.
+int generateMovesFiltered(Board *board, Move *moves) {
 	int moveCount = 0;
 	int side = board->sideToMove;
 	int opponent = side ^ 1;
@@ -253,7 +304,7 @@ int generateMoves(Board *board, Move *moves) {
 	for (int square = 0; square < 64; square++) {
 
 		// Pawns
-		if ((board->pawns[side] >> square) & 1) {
+		if ((board->bb[side][PAWN] >> square) & 1) {
 			int rank = square / 8;
 			int file = square % 8;
 			int forwardRank = (side == WHITE) ? rank + 1 : rank - 1;
@@ -263,17 +314,17 @@ int generateMoves(Board *board, Move *moves) {
 				uint64_t forwardSquareMask = 1ULL << forwardSquare;
 
 				// Check if the forward square is not occupied
-				if (!(board->occupied[WHITE] & forwardSquareMask) && !(board->occupied[BLACK] & forwardSquareMask)) {
+				if (!(board->bb[WHITE][ALL_PIECES] & forwardSquareMask) && !(board->bb[BLACK][ALL_PIECES] & forwardSquareMask)) {
 					if (forwardRank == 0 || forwardRank == 7) { // It's a promotion
 						// Create a move for each possible promotion piece
 						int promotionPieces[] = {QUEEN, ROOK, BISHOP, KNIGHT};
 						for (int i = 0; i < 4; i++) {
-							Move m = CREATE_MOVE(square, forwardSquare, promotionPieces[i], EMPTY, 0, 0, 0, 0);
+							Move m = CREATE_PROMOTION(square, forwardSquare, promotionPieces[i]);
 							moves[moveCount++] = m;
 						}
 					} else { // Not a promotion
 						// Create move
-						Move m = CREATE_MOVE(square, forwardSquare, EMPTY, EMPTY, 0, 0, 0, 0);
+						Move m = CREATE_MOVE(square, forwardSquare);
 						moves[moveCount++] = m;
 					}
 				}
@@ -285,268 +336,90 @@ int generateMoves(Board *board, Move *moves) {
 					uint64_t doubleForwardSquareMask = 1ULL << doubleForwardSquare;
 
 					// Check if the two forward squares are not occupied
-					if (!(board->occupied[WHITE] & forwardSquareMask) && !(board->occupied[BLACK] & forwardSquareMask) && !(board->occupied[WHITE] & doubleForwardSquareMask) &&
-						!(board->occupied[BLACK] & doubleForwardSquareMask)) {
+					if (!(board->bb[WHITE][ALL_PIECES] & forwardSquareMask) && !(board->bb[BLACK][ALL_PIECES] & forwardSquareMask) && !(board->bb[WHITE][ALL_PIECES] & doubleForwardSquareMask) &&
+						!(board->bb[BLACK][ALL_PIECES] & doubleForwardSquareMask)) {
 						// Create move
-						Move m = CREATE_MOVE(square, doubleForwardSquare, EMPTY, EMPTY, 0, 0, 1, 0);
+						Move m = CREATE_MOVE(square, doubleForwardSquare);
 						moves[moveCount++] = m;
 					}
 				}
 			}
 
 			// Generate pawn capture moves
-			int captureOffsets[2] = {(side == WHITE) ? -1 : 1, (side == WHITE) ? 1 : -1};
-			for (int i = 0; i < 2; i++) {
-				int targetRank = rank + (side == WHITE ? 1 : -1);
-				int targetFile = file + captureOffsets[i];
-
-				if (targetRank >= 0 && targetRank < 8 && targetFile >= 0 && targetFile < 8) {
-					int toSquare = targetRank * 8 + targetFile;
-					uint64_t toSquareMask = 1ULL << toSquare;
-
-					// Check if the target square is occupied by a piece of the opposite color
-					if (board->occupied[opponent] & toSquareMask) {
-						int capturedPiece = EMPTY;
-						if (board->pawns[opponent] & toSquareMask)
-							capturedPiece = PAWN;
-						else if (board->knights[opponent] & toSquareMask)
-							capturedPiece = KNIGHT;
-						else if (board->bishops[opponent] & toSquareMask)
-							capturedPiece = BISHOP;
-						else if (board->rooks[opponent] & toSquareMask)
-							capturedPiece = ROOK;
-						else if (board->queens[opponent] & toSquareMask)
-							capturedPiece = QUEEN;
-						else if (board->kings[opponent] & toSquareMask)
-							capturedPiece = KING;
-						else
-							capturedPiece = EMPTY;
-						// Create move
-						if (targetRank == 0 || targetRank == 7) { // It's a promotion during capture
-							// Create a move for each possible promotion piece
-							int promotionPieces[] = {QUEEN, ROOK, BISHOP, KNIGHT};
-							for (int i = 0; i < 4; i++) {
-								Move m = CREATE_MOVE(square, toSquare, promotionPieces[i], capturedPiece, 0, 0, 0, 0);
-								moves[moveCount++] = m;
-							}
-						} else { // Not a promotion
-							// Create move
-							Move m = CREATE_MOVE(square, toSquare, EMPTY, capturedPiece, 0, 0, 0, 0);
-							moves[moveCount++] = m;
-						}
-					}
-				}
-			}
+			uint64_t captures = pawnAttacks[side][square] & board->bb[opponent][ALL_PIECES];
+			while (captures) {
+				int toSquare = __builtin_ctzll(captures);
+				int targetRank = toSquare / 8;
+				captures &= captures - 1;
 
-			// Generate en passant moves
-			if (board->enPassantSquare != -1) {
-				int rank = square / 8;
-				int file = square % 8;
-
-				int targetRank = board->enPassantSquare / 8;
-				int targetFile = board->enPassantSquare % 8;
-
-				// The en passant square is always adjacent to the capturing pawn, so the rank should be the same as the pawn's target rank, and the file should be one off.
-				if (targetRank == rank + (side == WHITE ? 1 : -1) && (targetFile == file + 1 || targetFile == file - 1)) {
-					uint64_t toSquareMask = 1ULL << board->enPassantSquare;
-
-					// Check if the en passant square is not occupied
-					if (!(board->occupied[WHITE] & toSquareMask) && !(board->occupied[BLACK] & toSquareMask)) {
-						// Create move
-						Move m = CREATE_MOVE(square, board->enPassantSquare, EMPTY, PAWN, 1, 0, 0, 0);
-
-						// Add generated move to the movelist
+				// Create move
+				if (targetRank == 0 || targetRank == 7) { // It's a promotion during capture
+					// Create a move for each possible promotion piece
+					int promotionPieces[] = {QUEEN, ROOK, BISHOP, KNIGHT};
+					for (int i = 0; i < 4; i++) {
+						Move m = CREATE_PROMOTION(square, toSquare, promotionPieces[i]);
 						moves[moveCount++] = m;
 					}
-				}
-			}
-		}
-
-		// Knights
-		if ((board->knights[side] >> square) & 1) {
-			int rank = square / 8;
-			int file = square % 8;
-
-			for (int i = 0; i < 8; i++) {
-				int targetRank = rank + knightRankOffsets[i];
-				int targetFile = file + knightFileOffsets[i];
-
-				if (targetRank >= 0 && targetRank < 8 && targetFile >= 0 && targetFile < 8) {
-					int toSquare = targetRank * 8 + targetFile;
-					uint64_t toSquareMask = 1ULL << toSquare;
-
-					// Check if the target square is occupied by a piece of the same color
-					if (board->occupied[side] & toSquareMask) {
-						continue; // Skip this move
-					}
-
-					int capturedPiece = EMPTY;
-					// Check if the target square is occupied by a piece of the opposite color
-					if (board->occupied[opponent] & toSquareMask) {
-						if (board->pawns[opponent] & toSquareMask)
-							capturedPiece = PAWN;
-						else if (board->knights[opponent] & toSquareMask)
-							capturedPiece = KNIGHT;
-						else if (board->bishops[opponent] & toSquareMask)
-							capturedPiece = BISHOP;
-						else if (board->rooks[opponent] & toSquareMask)
-							capturedPiece = ROOK;
-						else if (board->queens[opponent] & toSquareMask)
-							capturedPiece = QUEEN;
-						else if (board->kings[opponent] & toSquareMask)
-							capturedPiece = KING;
-						else
-							capturedPiece = EMPTY;
-					}
-
+				} else { // Not a promotion
 					// Create move
-					Move m = CREATE_MOVE(square, toSquare, EMPTY, capturedPiece, 0, 0, 0, 0);
-
-					// Add generated moves to the movelist
+					Move m = CREATE_MOVE(square, toSquare);
 					moves[moveCount++] = m;
 				}
 			}
-		}
-
-		// Bishops and diagonally moving Queens
-		if (((board->bishops[side] | board->queens[side]) >> square) & 1) {
-			const int directionOffsets[4] = {-9, -7, 7, 9}; // Represents the directions in which a bishop can move
-
-			for (int i = 0; i < 4; i++) {
-				for (int targetSquare = square + directionOffsets[i]; targetSquare >= 0 && targetSquare < 64; targetSquare += directionOffsets[i]) {
-					// If the bishop moved off the board to the left or right, stop checking this direction
-					if (abs(targetSquare % 8 - (targetSquare - directionOffsets[i]) % 8) > 2) {
-						break;
-					}
 
-					uint64_t targetSquareMask = 1ULL << targetSquare;
-					int capturedPiece = EMPTY;
-
-					// If the target square is occupied by a piece of the same color, stop checking this direction
-					if (board->occupied[side] & targetSquareMask) {
-						break;
-					}
-
-					// Check if the target square is occupied by a piece of the opposite color
-					if (board->occupied[opponent] & targetSquareMask) {
-						if (board->pawns[opponent] & targetSquareMask)
-							capturedPiece = PAWN;
-						else if (board->knights[opponent] & targetSquareMask)
-							capturedPiece = KNIGHT;
-						else if (board->bishops[opponent] & targetSquareMask)
-							capturedPiece = BISHOP;
-						else if (board->rooks[opponent] & targetSquareMask)
-							capturedPiece = ROOK;
-						else if (board->queens[opponent] & targetSquareMask)
-							capturedPiece = QUEEN;
-						else if (board->kings[opponent] & targetSquareMask)
-							capturedPiece = KING;
-						else
-							capturedPiece = EMPTY;
-					}
+			// Generate en passant moves
+			// The pawn must attack the en passant square, which lies behind the pawn that just moved two squares
+			if (board->enPassantSquare != -1 && (pawnAttacks[side][square] >> board->enPassantSquare) & 1) {
+				uint64_t toSquareMask = 1ULL << board->enPassantSquare;
 
+				// Check if the en passant square is not occupied
+				if (!(board->bb[WHITE][ALL_PIECES] & toSquareMask) && !(board->bb[BLACK][ALL_PIECES] & toSquareMask)) {
 					// Create move
-					Move m = CREATE_MOVE(square, targetSquare, EMPTY, capturedPiece, 0, 0, 0, 0);
+					Move m = CREATE_SPECIAL_MOVE(square, board->enPassantSquare, MOVE_EN_PASSANT);
+
 					// Add generated move to the movelist
 					moves[moveCount++] = m;
-
-					// If the target square is occupied (either by same color or opponent), stop checking this direction
-					if (board->occupied[WHITE] & targetSquareMask || board->occupied[BLACK] & targetSquareMask) {
-						break;
-					}
 				}
 			}
 		}
-		// rooks and orthogonally moving Queens
-		if (((board->rooks[side] | board->queens[side]) >> square) & 1) {
-			const int directionOffsets[4] = {-8, 8, -1, 1}; // Represents the directions in which a rook can move
-
-			for (int i = 0; i < 4; i++) {
-				for (int targetSquare = square + directionOffsets[i]; targetSquare >= 0 && targetSquare < 64; targetSquare += directionOffsets[i]) {
-					// If the rook moved off the board to the left or right, stop checking this direction
-					if (abs(targetSquare % 8 - (targetSquare - directionOffsets[i]) % 8) > 1) {
-						break;
-					}
-
-					uint64_t targetSquareMask = 1ULL << targetSquare;
-					int capturedPiece = EMPTY;
-
-					// If the target square is occupied by a piece of the same color, stop checking this direction
-					if (board->occupied[side] & targetSquareMask) {
-						break;
-					}
 
-					// Check if the target square is occupied by a piece of the opposite color
-					if (board->occupied[opponent] & targetSquareMask) {
-						if (board->pawns[opponent] & targetSquareMask)
-							capturedPiece = PAWN;
-						else if (board->knights[opponent] & targetSquareMask)
-							capturedPiece = KNIGHT;
-						else if (board->bishops[opponent] & targetSquareMask)
-							capturedPiece = BISHOP;
-						else if (board->rooks[opponent] & targetSquareMask)
-							capturedPiece = ROOK;
-						else if (board->queens[opponent] & targetSquareMask)
-							capturedPiece = QUEEN;
-						else if (board->kings[opponent] & targetSquareMask)
-							capturedPiece = KING;
-						else
-							capturedPiece = EMPTY;
-					}
+		// Knights, bishops, rooks and queens: one table lookup gives every reachable square
+		if (((board->bb[side][KNIGHT] | board->bb[side][BISHOP] | board->bb[side][ROOK] | board->bb[side][QUEEN]) >> square) & 1) {
+			uint64_t occupancy = board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES];
+			uint64_t attacks = 0;
+			if ((board->bb[side][KNIGHT] >> square) & 1) {
+				attacks = knightAttacks[square];
+			}
+			if (((board->bb[side][BISHOP] | board->bb[side][QUEEN]) >> square) & 1) {
+				attacks |= bishop_attacks(square, occupancy);
+			}
+			if (((board->bb[side][ROOK] | board->bb[side][QUEEN]) >> square) & 1) {
+				attacks |= rook_attacks(square, occupancy);
+			}
+			// Squares occupied by a piece of the same color can't be moved to
+			attacks &= ~board->bb[side][ALL_PIECES];
 
-					// Create move
-					Move m = CREATE_MOVE(square, targetSquare, EMPTY, capturedPiece, 0, 0, 0, 0);
-					// Add generated move to the movelist
-					moves[moveCount++] = m;
+			while (attacks) {
+				int targetSquare = __builtin_ctzll(attacks);
+				attacks &= attacks - 1;
 
-					// If the target square is occupied (either by same color or opponent), stop checking this direction
-					if (board->occupied[WHITE] & targetSquareMask || board->occupied[BLACK] & targetSquareMask) {
-						break;
-					}
-				}
+				// Create move
+				Move m = CREATE_MOVE(square, targetSquare);
+				// Add generated move to the movelist
+				moves[moveCount++] = m;
 			}
 		}
 
 		// Kings
-		if ((board->kings[side] >> square) & 1) {
-			const int kingOffsets[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
+		if ((board->bb[side][KING] >> square) & 1) {
+			uint64_t attacks = kingAttacks[square] & ~board->bb[side][ALL_PIECES];
 
-			for (int i = 0; i < 8; i++) {
-				int targetSquare = square + kingOffsets[i];
-
-				// Check that the king isn't going off the edges of the board
-				if (targetSquare < 0 || targetSquare >= 64 || abs(targetSquare % 8 - (targetSquare - kingOffsets[i]) % 8) > 2) {
-					continue;
-				}
-
-				uint64_t targetSquareMask = 1ULL << targetSquare;
-				int capturedPiece = EMPTY;
-
-				// If the target square is occupied by a piece of the same color, skip this square
-				if (board->occupied[side] & targetSquareMask) {
-					continue;
-				}
-
-				// Check if the target square is occupied by a piece of the opposite color
-				if (board->occupied[opponent] & targetSquareMask) {
-					if (board->pawns[opponent] & targetSquareMask)
-						capturedPiece = PAWN;
-					else if (board->knights[opponent] & targetSquareMask)
-						capturedPiece = KNIGHT;
-					else if (board->bishops[opponent] & targetSquareMask)
-						capturedPiece = BISHOP;
-					else if (board->rooks[opponent] & targetSquareMask)
-						capturedPiece = ROOK;
-					else if (board->queens[opponent] & targetSquareMask)
-						capturedPiece = QUEEN;
-					else if (board->kings[opponent] & targetSquareMask)
-						capturedPiece = KING;
-					else
-						capturedPiece = EMPTY;
-				}
+			while (attacks) {
+				int targetSquare = __builtin_ctzll(attacks);
+				attacks &= attacks - 1;
 
 				// Create move
-				Move m = CREATE_MOVE(square, targetSquare, EMPTY, capturedPiece, 0, 0, 0, 0);
+				Move m = CREATE_MOVE(square, targetSquare);
 				// Add generated move to the movelist
 				moves[moveCount++] = m;
 			}
@@ -557,20 +430,20 @@ int generateMoves(Board *board, Move *moves) {
 				// Kingside
 				if (board->castleRights[WHITE] & 1 << 0) {
 					// Check that squares between the king and the rook are not occupied and not attacked
-					if (!((board->occupied[WHITE] | board->occupied[BLACK]) & ((1ULL << (0 * 8 + 5)) | (1ULL << (0 * 8 + 6)))) && !is_square_attacked(board, 0 * 8 + 5) &&
+					if (!((board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES]) & ((1ULL << (0 * 8 + 5)) | (1ULL << (0 * 8 + 6)))) && !is_square_attacked(board, 0 * 8 + 5) &&
 						!is_square_attacked(board, 0 * 8 + 6) && !is_square_attacked(board, square)) {
 						// If it's safe, generate a castling move
-						Move m = CREATE_MOVE(square, 0 * 8 + 6, EMPTY, EMPTY, 0, 1, 0, 0);
+						Move m = CREATE_SPECIAL_MOVE(square, 0 * 8 + 6, MOVE_CASTLING);
 						moves[moveCount++] = m;
 					}
 				}
 				// Queenside
 				if (board->castleRights[WHITE] & 1 << 1) {
 					// Check that squares between the king and the rook are not occupied and not attacked
-					if (!((board->occupied[WHITE] | board->occupied[BLACK]) & ((1ULL << (0 * 8 + 3)) | (1ULL << (0 * 8 + 2)) | (1ULL << (0 * 8 + 1)))) && !is_square_attacked(board, 0 * 8 + 3) &&
+					if (!((board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES]) & ((1ULL << (0 * 8 + 3)) | (1ULL << (0 * 8 + 2)) | (1ULL << (0 * 8 + 1)))) && !is_square_attacked(board, 0 * 8 + 3) &&
 						!is_square_attacked(board, 0 * 8 + 2) && !is_square_attacked(board, square)) {
 						// If it's safe, generate a castling move
-						Move m = CREATE_MOVE(square, 0 * 8 + 2, EMPTY, EMPTY, 0, 1, 0, 0);
+						Move m = CREATE_SPECIAL_MOVE(square, 0 * 8 + 2, MOVE_CASTLING);
 						moves[moveCount++] = m;
 					}
 				}
@@ -580,20 +453,20 @@ int generateMoves(Board *board, Move *moves) {
 				// Kingside
 				if (board->castleRights[BLACK] & 1 << 0) {
 					// Check that squares between the king and the rook are not occupied and not attacked
-					if (!((board->occupied[WHITE] | board->occupied[BLACK]) & ((1ULL << (7 * 8 + 5)) | (1ULL << (7 * 8 + 6)))) && !is_square_attacked(board, 7 * 8 + 5) &&
+					if (!((board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES]) & ((1ULL << (7 * 8 + 5)) | (1ULL << (7 * 8 + 6)))) && !is_square_attacked(board, 7 * 8 + 5) &&
 						!is_square_attacked(board, 7 * 8 + 6) && !is_square_attacked(board, square)) {
 						// If it's safe, generate a castling move
-						Move m = CREATE_MOVE(square, 7 * 8 + 6, EMPTY, EMPTY, 0, 1, 0, 0);
+						Move m = CREATE_SPECIAL_MOVE(square, 7 * 8 + 6, MOVE_CASTLING);
 						moves[moveCount++] = m;
 					}
 				}
 				// Queenside
 				if (board->castleRights[BLACK] & 1 << 1) {
 					// Check that squares between the king and the rook are not occupied and not attacked
-					if (!((board->occupied[WHITE] | board->occupied[BLACK]) & ((1ULL << (7 * 8 + 3)) | (1ULL << (7 * 8 + 2)) | (1ULL << (7 * 8 + 1)))) && !is_square_attacked(board, 7 * 8 + 3) &&
+					if (!((board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES]) & ((1ULL << (7 * 8 + 3)) | (1ULL << (7 * 8 + 2)) | (1ULL << (7 * 8 + 1)))) && !is_square_attacked(board, 7 * 8 + 3) &&
 						!is_square_attacked(board, 7 * 8 + 2) && !is_square_attacked(board, square)) {
 						// If it's safe, generate a castling move
-						Move m = CREATE_MOVE(square, 7 * 8 + 2, EMPTY, EMPTY, 0, 1, 0, 0);
+						Move m = CREATE_SPECIAL_MOVE(square, 7 * 8 + 2, MOVE_CASTLING);
 						moves[moveCount++] = m;
 					}
 				}
@@ -602,18 +475,21 @@ int generateMoves(Board *board, Move *moves) {
 	}
 
 	// Finally, filter out any moves that would leave the king in check
-	Board tempBoard;
+	Undo undo;
 	Move tempMoves[moveCount];
 	int newMoveCount = 0;
 	// printf("Pseudolegal moves: %d\n",moveCount);
 
 	for (int i = 0; i < moveCount; i++) {
-		tempBoard = *board;
-		make_move(&tempBoard, moves[i]);
-		tempBoard.sideToMove ^= 1;
-		int tempKingSquare = __builtin_ffsll(tempBoard.kings[board->sideToMove]) - 1;
-
-		if (!is_square_attacked(&tempBoard, tempKingSquare)) {
+		make_move(board, moves[i], &undo);
+		// Look at the king from the moving side's point of view
+		board->sideToMove ^= 1;
+		int tempKingSquare = __builtin_ffsll(board->bb[board->sideToMove][KING]) - 1;
+		int inCheck = is_square_attacked(board, tempKingSquare);
+		board->sideToMove ^= 1;
+		unmake_move(board, &undo);
+
+		if (!inCheck) {
 			tempMoves[newMoveCount] = moves[i];
 			newMoveCount++;
 		}
@@ -631,7 +507,285 @@ int generateMoves(Board *board, Move *moves) {
 }
 
 
+// Pieces of 'side' that stand alone between their king and an enemy slider
+static uint64_t pinnedPieces(const Board *board, int side, int kingSquare) {
+	int opponent = side ^ 1;
+	uint64_t occupancy = board->bb[WHITE][ALL_PIECES] | board->bb[BLACK][ALL_PIECES];
+	uint64_t pinned = 0;
+	uint64_t snipers = (rook_attacks(kingSquare, 0) & (board->bb[opponent][ROOK] | board->bb[opponent][QUEEN])) |
+					   (bishop_attacks(kingSquare, 0) & (board->bb[opponent][BISHOP] | board->bb[opponent][QUEEN]));
+
+	while (snipers) {
+		int sniperSquare = __builtin_ctzll(snipers);
+		uint64_t blockers = squaresBetween[kingSquare][sniperSquare] & occupancy;
+		snipers &= snipers - 1;
+
+		if (blockers && !(blockers & (blockers - 1))) {
+			pinned |= blockers & board->bb[side][ALL_PIECES];
+		}
+	}
+	return pinned;
+}
+
+// Add one move; with moves == NULL only count it
+static inline int addMove(Move *moves, int moveCount, Move move) {
+	if (moves != NULL) {
+		moves[moveCount] = move;
+	}
+	return moveCount + 1;
+}
+
+// Add a move from 'from' to every square in 'targets'
+// With moves == NULL (counting, see countMoves) only the count advances.
+static inline int addMoves(Move *moves, int moveCount, int from, uint64_t targets) {
+	if (moves == NULL) {
+		return moveCount + __builtin_popcountll(targets);
+	}
+	while (targets) {
+		int to = __builtin_ctzll(targets);
+		targets &= targets - 1;
+		moves[moveCount++] = CREATE_MOVE(from, to);
+	}
+	return moveCount;
+}
 
+// Add a pawn move, expanding it into the four promotions on the last rank
+static inline int addPawnMove(Move *moves, int moveCount, int from, int to) {
+	if (moves == NULL) {
+		return moveCount + ((to / 8 == 0 || to / 8 == 7) ? 4 : 1);
+	}
+	if (to / 8 == 0 || to / 8 == 7) {
+		int promotionPieces[] = {QUEEN, ROOK, BISHOP, KNIGHT};
+		for (int i = 0; i < 4; i++) {
+			moves[moveCount++] = CREATE_PROMOTION(from, to, promotionPieces[i]);
+		}
+	} else {
+		moves[moveCount++] = CREATE_MOVE(from, to);
+	}
+	return moveCount;
+}
+
+// Which moves generate() emits
+#define GEN_ALL 0
+#define GEN_CAPTURES 1 // captures, en passant and all promotions
+#define GEN_QUIETS 2   // everything else, castling included
+
+// Legal move generator. Checkers and pinned pieces are computed once, so every
+// move it emits is legal without making it:
+// - the king may only go to squares the opponent does not attack once the king has left its square
+// - in double check only the king moves
+// - in single check the other pieces must capture the checker or block the check
+// - a pinned piece stays on the line through its king and the pinner
+// Only pieces standing on fromMask are considered. With moves == NULL nothing is
+// written and only the count is returned. side is the side to move and,
+// as in make_move_side, always a constant so the color tests fold away.
+static inline __attribute__((always_inline)) int generate_side(Board *board, Move *moves, int type, uint64_t fromMask, const int side) {
+	int moveCount = 0;
+	const int opponent = side ^ 1;
+	uint64_t own = board->bb[side][ALL_PIECES];
+	uint64_t enemy = board->bb[opponent][ALL_PIECES];
+	uint64_t occupancy = own | enemy;
+	int kingSquare = __builtin_ctzll(board->bb[side][KING]);
+	uint64_t kingMask = 1ULL << kingSquare;
+
+	uint64_t checkers = attackers_to(board, kingSquare, occupancy) & enemy;
+	uint64_t pinned = pinnedPieces(board, side, kingSquare);
+
+	// Destination squares allowed by the requested move type
+	uint64_t typeMask = (type == GEN_CAPTURES) ? enemy : (type == GEN_QUIETS) ? ~occupancy : ~own;
+
+	// King moves. The king is taken off the board so sliders see through it along the line of check.
+	uint64_t kingTargets = (fromMask & kingMask) ? kingAttacks[kingSquare] & ~own & typeMask : 0;
+	while (kingTargets) {
+		int to = __builtin_ctzll(kingTargets);
+		kingTargets &= kingTargets - 1;
+		if (!(attackers_to(board, to, occupancy ^ kingMask) & enemy)) {
+			moveCount = addMove(moves, moveCount, CREATE_MOVE(kingSquare, to));
+		}
+	}
+
+	// Double check: nothing but a king move helps
+	if (checkers & (checkers - 1)) {
+		return moveCount;
+	}
+
+	// Squares the other pieces may move to: anywhere but their own pieces,
+	// or when in check only onto the checker or between it and the king
+	uint64_t targetMask = ~own;
+	if (checkers) {
+		targetMask = checkers | squaresBetween[kingSquare][__builtin_ctzll(checkers)];
+	}
+
+	// Knights. A pinned knight can never move.
+	uint64_t knights = board->bb[side][KNIGHT] & ~pinned & fromMask;
+	while (knights) {
+		int from = __builtin_ctzll(knights);
+		knights &= knights - 1;
+		moveCount = addMoves(moves, moveCount, from, knightAttacks[from] & targetMask & typeMask);
+	}
+
+	// Bishops, rooks and queens
+	uint64_t sliders = (board->bb[side][BISHOP] | board->bb[side][ROOK] | board->bb[side][QUEEN]) & fromMask;
+	while (sliders) {
+		int from = __builtin_ctzll(sliders);
+		uint64_t fromBit = 1ULL << from;
+		uint64_t attacks = 0;
+		sliders &= sliders - 1;
+
+		if ((board->bb[side][BISHOP] | board->bb[side][QUEEN]) & fromBit) {
+			attacks |= bishop_attacks(from, occupancy);
+		}
+		if ((board->bb[side][ROOK] | board->bb[side][QUEEN]) & fromBit) {
+			attacks |= rook_attacks(from, occupancy);
+		}
+		attacks &= targetMask & typeMask;
+		if (pinned & fromBit) {
+			attacks &= lineThrough[kingSquare][from];
+		}
+		moveCount = addMoves(moves, moveCount, from, attacks);
+	}
+
+	// Pawns. Pushes onto the last rank are promotions and count as captures.
+	int forward = (side == WHITE) ? 8 : -8;
+	uint64_t startRank = (side == WHITE) ? 0x000000000000FF00ULL : 0x00FF000000000000ULL;
+	uint64_t lastRank = (side == WHITE) ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+	uint64_t pawns = board->bb[side][PAWN] & fromMask;
+	while (pawns) {
+		int from = __builtin_ctzll(pawns);
+		uint64_t fromBit = 1ULL << from;
+		uint64_t allowed = (pinned & fromBit) ? targetMask & lineThrough[kingSquare][from] : targetMask;
+		pawns &= pawns - 1;
+
+		// Pushes
+		int to = from + forward;
+		uint64_t toBit = 1ULL << to;
+		if (!(occupancy & toBit)) {
+			if ((allowed & toBit) && ((lastRank & toBit) ? type != GEN_QUIETS : type != GEN_CAPTURES)) {
+				moveCount = addPawnMove(moves, moveCount, from, to);
+			}
+			int doubleTo = to + forward;
+			if (type != GEN_CAPTURES && (startRank & fromBit) && !(occupancy & (1ULL << doubleTo)) && (allowed & (1ULL << doubleTo))) {
+				moveCount = addPawnMove(moves, moveCount, from, doubleTo);
+			}
+		}
+
+		if (type == GEN_QUIETS) {
+			continue;
+		}
+
+		// Captures
+		uint64_t captures = pawnAttacks[side][from] & enemy & allowed;
+		while (captures) {
+			to = __builtin_ctzll(captures);
+			captures &= captures - 1;
+			moveCount = addPawnMove(moves, moveCount, from, to);
+		}
+
+		// En passant. Two pawns leave the same rank at once, which can uncover a check
+		// no pin mask sees, so test the king directly on the resulting occupancy.
+		if (board->enPassantSquare != -1 && (pawnAttacks[side][from] >> board->enPassantSquare) & 1) {
+			int epSquare = board->enPassantSquare;
+			uint64_t capturedMask = 1ULL << (epSquare - forward);
+			uint64_t after = (occupancy ^ fromBit ^ capturedMask) | (1ULL << epSquare);
+			if (!(attackers_to(board, kingSquare, after) & enemy & ~capturedMask)) {
+				moveCount = addMove(moves, moveCount, CREATE_SPECIAL_MOVE(from, epSquare, MOVE_EN_PASSANT));
+			}
+		}
+	}
+
+	// Castling, never out of check. The squares between king and rook must be empty
+	// and the squares the king crosses must not be attacked.
+	if (!checkers && type != GEN_CAPTURES && (fromMask & kingMask)) {
+		int backRank = (side == WHITE) ? 0 : 56;
+		if ((board->castleRights[side] & (1 << KINGSIDE_CASTLING)) && !(occupancy & (0x60ULL << backRank)) &&
+			!(attackers_to(board, backRank + 5, occupancy) & enemy) && !(attackers_to(board, backRank + 6, occupancy) & enemy)) {
+			moveCount = addMove(moves, moveCount, CREATE_SPECIAL_MOVE(kingSquare, backRank + 6, MOVE_CASTLING));
+		}
+		if ((board->castleRights[side] & (1 << QUEENSIDE_CASTLING)) && !(occupancy & (0x0EULL << backRank)) &&
+			!(attackers_to(board, backRank + 3, occupancy) & enemy) && !(attackers_to(board, backRank + 2, occupancy) & enemy)) {
+			moveCount = addMove(moves, moveCount, CREATE_SPECIAL_MOVE(kingSquare, backRank + 2, MOVE_CASTLING));
+		}
+	}
+
+	return moveCount;
+}
+
+static int generate_white(Board *board, Move *moves, int type, uint64_t fromMask) {
+	return generate_side(board, moves, type, fromMask, WHITE);
+}
+
+static int generate_black(Board *board, Move *moves, int type, uint64_t fromMask) {
+	return generate_side(board, moves, type, fromMask, BLACK);
+}
+
+// Count-only instances: moves is a constant NULL, so no move is ever stored
+static int count_white(Board *board) {
+	return generate_side(board, NULL, GEN_ALL, ~0ULL, WHITE);
+}
+
+static int count_black(Board *board) {
+	return generate_side(board, NULL, GEN_ALL, ~0ULL, BLACK);
+}
+
+static int (*const countBySide[2])(Board *board) = {count_white, count_black};
+
+static int (*const generateBySide[2])(Board *board, Move *moves, int type, uint64_t fromMask) = {generate_white, generate_black};
+
+static int generate(Board *board, Move *moves, int type, uint64_t fromMask) {
+	return generateBySide[board->sideToMove](board, moves, type, fromMask);
+}
+
+// All legal moves
+int generateMoves(Board *board, Move *moves) {
+	int moveCount = generate(board, moves, GEN_ALL, ~0ULL);
+
+#ifdef DEBUG_MOVEGEN
+	// Cross-check against the copy-make filter
+	Move reference[MAX_MOVES + 64];
+	int referenceCount = generateMovesFiltered(board, reference);
+	if (referenceCount != moveCount) {
+		fprintf(stderr, "generateMoves: %d legal moves, filter found %d\n", moveCount, referenceCount);
+		printBoard(board);
+		abort();
+	}
+	// The incrementally updated keys must match a recomputation
+	if (board->zobristKey != compute_zobrist_key(board) || board->pawnKey != compute_pawn_key(board) || board->materialKey != compute_material_key(board)) {
+		fprintf(stderr, "generateMoves: incremental hash keys differ from recomputed ones\n");
+		printBoard(board);
+		abort();
+	}
+#endif
+
+	return moveCount;
+}
+
+// Number of legal moves, without writing a move list
+int countMoves(Board *board) {
+	return countBySide[board->sideToMove](board);
+}
+
+// Legal captures, en passant captures and promotions
+int generateCaptures(Board *board, Move *moves) {
+	return generate(board, moves, GEN_CAPTURES, ~0ULL);
+}
+
+// Legal moves that neither capture nor promote
+int generateQuiets(Board *board, Move *moves) {
+	return generate(board, moves, GEN_QUIETS, ~0ULL);
+}
+
+// Whether a move (e.g. a killer remembered from another position) is legal here.
+// Only the moves of the piece on its from square are generated.
+int isLegalMove(Board *board, Move move) {
+	Move moves[MAX_MOVES];
+	int moveCount = generate(board, moves, GEN_ALL, 1ULL << FROM_SQUARE(move));
+	for (int i = 0; i < moveCount; i++) {
+		if (moves[i] == move) {
+			return 1;
+		}
+	}
+	return 0;
+}
 
 void printMove(Move move) {
 	int from = FROM_SQUARE(move);
@@ -3,9 +3,9 @@
 
 #include "board.h"
 
-typedef enum { EMPTY = 0, PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING } Piece;
-
-typedef uint64_t Move;
+// A move fits in 16 bits, small enough for killer slots, hash entries and books.
+// What it captures is read from the board, and ordering scores live in ScoredMove.
+typedef uint16_t Move;
 #define MAX_MOVES 218
 
 // Bits 0-5 store the 'from' square (0 to 63)
@@ -14,29 +14,61 @@ typedef uint64_t Move;
 // Bits 6-11 store the 'to' square (0 to 63)
 #define TO_SQUARE(move) (((move) >> 6) & 0x3F)
 
-// Bits 12-14 store the promoted piece (QUEEN = 5, ROOK = 4, BISHOP = 3, KNIGHT = 2)
-#define PROMOTED_PIECE(move) (((move) >> 12) & 0x7)
+// Bits 14-15 store the move type
+#define MOVE_NORMAL 0
+#define MOVE_PROMOTION (1 << 14)
+#define MOVE_EN_PASSANT (2 << 14)
+#define MOVE_CASTLING (3 << 14)
+#define MOVE_TYPE(move) ((move)&0xC000)
+
+// Bits 12-13 store the promoted piece minus KNIGHT; EMPTY unless the move is a promotion
+#define PROMOTED_PIECE(move) (MOVE_TYPE(move) == MOVE_PROMOTION ? KNIGHT + (((move) >> 12) & 0x3) : EMPTY)
 
-// Bits 15-17 store the captured piece (same encoding as promoted piece)
-#define CAPTURED_PIECE(move) (((move) >> 15) & 0x7)
+#define IS_EN_PASSANT(move) (MOVE_TYPE(move) == MOVE_EN_PASSANT)
+#define IS_CASTLING(move) (MOVE_TYPE(move) == MOVE_CASTLING)
 
-// Bit 18 is for en passant
-#define IS_EN_PASSANT(move) (((move) >> 18) & 0x1)
+#define CREATE_MOVE(from, to) ((Move)((from) | ((to) << 6)))
+#define CREATE_SPECIAL_MOVE(from, to, type) ((Move)((from) | ((to) << 6) | (type)))
+#define CREATE_PROMOTION(from, to, promotedPiece) ((Move)((from) | ((to) << 6) | (((promotedPiece)-KNIGHT) << 12) | MOVE_PROMOTION))
 
-// Bit 19 is for castling
-#define IS_CASTLING(move) (((move) >> 19) & 0x1)
+// A move with its ordering score, for move pickers
+typedef struct {
+  Move move;
+  int score;
+} ScoredMove;
 
-// Bit 20 is for pawn double move
-#define IS_DOUBLE_PAWN_MOVE(move) (((move) >> 20) & 0x1)
+// Piece type the move takes, EMPTY if none. Must be called before the move is made.
+static inline int capturedPieceOf(const Board *board, Move move) {
+	return IS_EN_PASSANT(move) ? PAWN : board->squares[TO_SQUARE(move)];
+}
 
-// Bits 21-31 store the move score (range -1024 to 1023)
-#define MOVE_SCORE(move) ((int8_t)(((move) >> 21) & 0xFF))
+// Neither a capture nor a promotion
+static inline int isQuietMove(const Board *board, Move move) {
+	return capturedPieceOf(board, move) == EMPTY && PROMOTED_PIECE(move) == EMPTY;
+}
 
-#define CREATE_MOVE(from, to, promotedPiece, capturedPiece, enPassant, castling, doublePawnMove, score)                                                                                                \
-	((from) | ((to) << 6) | ((promotedPiece) << 12) | ((capturedPiece) << 15) | ((enPassant) << 18) | ((castling) << 19) | ((doublePawnMove) << 20) | ((score & 0xFF) << 21))
+// What make_move changes irreversibly, so unmake_move can restore it
+typedef struct {
+  Move move;
+  int movedPiece;      // piece type that moved, PAWN for promotions
+  int capturedPiece;   // piece type taken by the move, EMPTY if none
+  int castleRights[2]; // before the move
+  int enPassantSquare; // before the move
+  uint64_t zobristKey; // before the move
+  uint64_t pawnKey;
+  uint64_t materialKey;
+} Undo;
 
 int generateMoves(Board *board, Move *moves);
-void make_move(Board *board, Move move);
+int countMoves(Board *board);
+int generateCaptures(Board *board, Move *moves);
+int generateQuiets(Board *board, Move *moves);
+int isLegalMove(Board *board, Move move);
+int generateMovesFiltered(Board *board, Move *moves);
+void make_move(Board *board, Move move, Undo *undo);
+void unmake_move(Board *board, const Undo *undo);
+void make_null_move(Board *board, Undo *undo);
+void unmake_null_move(Board *board, const Undo *undo);
 void printMove(Move move);
 
 #endif
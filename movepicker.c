@@ -0,0 +1,150 @@
+#include <stddef.h>
+#include "movepicker.h"
+#include "evaluate.h"
+
+void initMovePicker(MovePicker *picker, Board *board, Move ttMove, const Move *killers, Move counterMove, const int (*history)[64]) {
+	picker->board = board;
+	picker->ttMove = ttMove;
+	picker->killers[0] = killers ? killers[0] : 0;
+	picker->killers[1] = (killers && killers[1] != killers[0]) ? killers[1] : 0;
+	picker->counterMove = (counterMove != picker->killers[0] && counterMove != picker->killers[1]) ? counterMove : 0;
+	picker->history = history;
+	picker->stage = STAGE_TT_MOVE;
+	picker->capturesOnly = 0;
+	picker->killerIndex = 0;
+	picker->moveCount = 0;
+	picker->moveIndex = 0;
+}
+
+// Captures and promotions only, for the quiescence search
+void initCapturePicker(MovePicker *picker, Board *board) {
+	initMovePicker(picker, board, 0, NULL, 0, NULL);
+	picker->stage = STAGE_GENERATE_CAPTURES;
+	picker->capturesOnly = 1;
+}
+
+// Copy a generated list into the picker with zero scores
+static void loadMoves(MovePicker *picker, const Move *list, int count) {
+	for (int i = 0; i < count; i++) {
+		picker->moves[i].move = list[i];
+		picker->moves[i].score = 0;
+	}
+	picker->moveCount = count;
+	picker->moveIndex = 0;
+}
+
+// MVV-LVA: most valuable victim first, the cheapest attacker breaks ties (piece
+// types are far smaller than the gaps between values); a promotion adds the value of the new piece
+static void scoreCaptures(MovePicker *picker) {
+	for (int i = 0; i < picker->moveCount; i++) {
+		Move move = picker->moves[i].move;
+		picker->moves[i].score = pieceValues[capturedPieceOf(picker->board, move)] + pieceValues[PROMOTED_PIECE(move)] -
+								 picker->board->squares[FROM_SQUARE(move)];
+	}
+}
+
+// Quiet moves by how often they cut off elsewhere in the tree
+static void scoreQuiets(MovePicker *picker) {
+	if (picker->history == NULL) {
+		return;
+	}
+	for (int i = 0; i < picker->moveCount; i++) {
+		Move move = picker->moves[i].move;
+		picker->moves[i].score = picker->history[FROM_SQUARE(move)][TO_SQUARE(move)];
+	}
+}
+
+// Swap the best scored remaining move to the front and return it.
+// Selection beats sorting here because most nodes only look at a few moves.
+static Move pickBest(MovePicker *picker) {
+	int best = picker->moveIndex;
+	for (int i = best + 1; i < picker->moveCount; i++) {
+		if (picker->moves[i].score > picker->moves[best].score) {
+			best = i;
+		}
+	}
+
+	ScoredMove scored = picker->moves[best];
+	picker->moves[best] = picker->moves[picker->moveIndex];
+	picker->moves[picker->moveIndex++] = scored;
+	return scored.move;
+}
+
+// Killers and the countermove have their own stages, the quiet stage skips them
+static int isRefutation(const MovePicker *picker, Move move) {
+	return move == picker->killers[0] || move == picker->killers[1] || move == picker->counterMove;
+}
+
+// Returns the next legal move, or 0 once all have been returned
+Move nextMove(MovePicker *picker) {
+	Move list[MAX_MOVES];
+	Move move;
+
+	switch (picker->stage) {
+	case STAGE_TT_MOVE:
+		picker->stage = STAGE_GENERATE_CAPTURES;
+		if (picker->ttMove && isLegalMove(picker->board, picker->ttMove)) {
+			return picker->ttMove;
+		}
+		// fall through
+
+	case STAGE_GENERATE_CAPTURES:
+		loadMoves(picker, list, generateCaptures(picker->board, list));
+		scoreCaptures(picker);
+		picker->stage = STAGE_CAPTURES;
+		// fall through
+
+	case STAGE_CAPTURES:
+		while (picker->moveIndex < picker->moveCount) {
+			move = pickBest(picker);
+			if (move != picker->ttMove) {
+				return move;
+			}
+		}
+		if (picker->capturesOnly) {
+			picker->stage = STAGE_DONE;
+			return 0;
+		}
+		picker->stage = STAGE_KILLERS;
+		// fall through
+
+	case STAGE_KILLERS:
+		// Killers are quiet moves that caused a cutoff in a sibling node; they may not be legal here
+		while (picker->killerIndex < 2) {
+			move = picker->killers[picker->killerIndex++];
+			if (move && move != picker->ttMove && isQuietMove(picker->board, move) && isLegalMove(picker->board, move)) {
+				return move;
+			}
+		}
+		picker->stage = STAGE_COUNTER_MOVE;
+		// fall through
+
+	case STAGE_COUNTER_MOVE:
+		// The quiet move that last refuted the opponent's previous move, same checks as the killers
+		picker->stage = STAGE_GENERATE_QUIETS;
+		move = picker->counterMove;
+		if (move && move != picker->ttMove && isQuietMove(picker->board, move) && isLegalMove(picker->board, move)) {
+			return move;
+		}
+		// fall through
+
+	case STAGE_GENERATE_QUIETS:
+		loadMoves(picker, list, generateQuiets(picker->board, list));
+		scoreQuiets(picker);
+		picker->stage = STAGE_QUIETS;
+		// fall through
+
+	case STAGE_QUIETS:
+		while (picker->moveIndex < picker->moveCount) {
+			move = pickBest(picker);
+			if (move != picker->ttMove && !isRefutation(picker, move)) {
+				return move;
+			}
+		}
+		picker->stage = STAGE_DONE;
+		// fall through
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef MOVEPICKER_H
+#define MOVEPICKER_H
+
+#include "board.h"
+#include "move.h"
+
+// Stages of the move picker, in the order moves are handed out
+typedef enum {
+  STAGE_TT_MOVE,
+  STAGE_GENERATE_CAPTURES,
+  STAGE_CAPTURES,
+  STAGE_KILLERS,
+  STAGE_COUNTER_MOVE,
+  STAGE_GENERATE_QUIETS,
+  STAGE_QUIETS,
+  STAGE_DONE
+} PickerStage;
+
+// Hands out the legal moves of a position one at a time: the hash move, then
+// captures best first, then the killers and the countermove, then the quiet
+// moves by history. Each stage is
+// generated only once the previous one is used up, so a cutoff on an early
+// move never pays for generating the rest.
+typedef struct {
+  Board *board;
+  Move ttMove;
+  Move killers[2];
+  Move counterMove;
+  const int (*history)[64]; // [from][to] for the side to move, NULL leaves quiets unordered
+  int stage;
+  int capturesOnly; // stop after the captures stage
+  int killerIndex;
+  int moveCount;
+  int moveIndex;
+  ScoredMove moves[MAX_MOVES];
+} MovePicker;
+
+void initMovePicker(MovePicker *picker, Board *board, Move ttMove, const Move *killers, Move counterMove, const int (*history)[64]);
+void initCapturePicker(MovePicker *picker, Board *board);
+Move nextMove(MovePicker *picker);
+
+#endif
@@ -2,14 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include "perft.h"
 #include "move.h"
+#include "tt.h"
+#include "uci.h"
 
 #define MAX_DEPTH 4
 
 uint64_t parseDepthResult(const char *line, int depth) {
-	char depthStr[5];
+	char depthStr[16];
 	sprintf(depthStr, "D%d ", depth);
 
 	char *start = strstr(line, depthStr);
@@ -21,18 +22,301 @@ uint64_t parseDepthResult(const char *line, int depth) {
 	return strtoull(start, NULL, 10);
 }
 
-void perftFromEPD(const char *filePath) {
+// Optional perft hash table: subtree counts keyed by zobristKey and depth.
+// Lockless like the transposition table, see TTEntry in tt.h.
+typedef struct {
+  uint64_t key;  // zobristKey ^ data
+  uint64_t data; // nodes << 8 | depth
+} PerftEntry;
+
+// Two entries per bucket: slot 0 keeps the deepest subtree, slot 1 the most recent
+typedef struct {
+  PerftEntry entries[2];
+} PerftBucket;
+
+static PerftBucket *perftTable = NULL;
+static uint64_t perftTableMask = 0;
+
+void perft_set_hash(size_t megabytes) {
+	free(perftTable);
+	perftTable = NULL;
+	perftTableMask = 0;
+	if (megabytes == 0) {
+		return;
+	}
+
+	uint64_t buckets = tt_bucket_count(megabytes, sizeof(PerftBucket));
+	perftTable = aligned_alloc(64, buckets * sizeof(PerftBucket));
+	if (perftTable == NULL) {
+		printf("info string Failed to allocate %zu MB for the perft hash\n", megabytes);
+		return;
+	}
+	memset(perftTable, 0, buckets * sizeof(PerftBucket));
+	perftTableMask = buckets - 1;
+}
+
+static int perft_probe(uint64_t key, int depth, uint64_t *nodes) {
+	PerftBucket *bucket = &perftTable[key & perftTableMask];
+	for (int i = 0; i < 2; i++) {
+		uint64_t entryKey = __atomic_load_n(&bucket->entries[i].key, __ATOMIC_RELAXED);
+		uint64_t data = __atomic_load_n(&bucket->entries[i].data, __ATOMIC_RELAXED);
+		if ((entryKey ^ data) == key && (int)(data & 0xFF) == depth) {
+			*nodes = data >> 8;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void perft_store(uint64_t key, int depth, uint64_t nodes) {
+	PerftBucket *bucket = &perftTable[key & perftTableMask];
+	uint64_t data = nodes << 8 | (uint64_t)depth;
+	uint64_t slotData = __atomic_load_n(&bucket->entries[0].data, __ATOMIC_RELAXED);
+	PerftEntry *entry = (int)(slotData & 0xFF) <= depth ? &bucket->entries[0] : &bucket->entries[1];
+	__atomic_store_n(&entry->key, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+// Bulk counting: at depth 1 the number of legal moves is the number of leaves,
+// so the last ply is counted by the generator and never made
+uint64_t perft_count(Board *board, int depth) {
+	if (depth <= 1) {
+		return depth == 1 ? (uint64_t)countMoves(board) : 1;
+	}
+
+	uint64_t nodes = 0;
+	if (perftTable != NULL && perft_probe(board->zobristKey, depth, &nodes)) {
+		return nodes;
+	}
+
+	Move moves[MAX_MOVES];
+	int moveCount = generateMoves(board, moves);
+
+	Undo undo;
+	for (int i = 0; i < moveCount; i++) {
+		make_move(board, moves[i], &undo);
+		nodes += perft_count(board, depth - 1);
+		unmake_move(board, &undo);
+	}
+
+	if (perftTable != NULL) {
+		perft_store(board->zobristKey, depth, nodes);
+	}
+	return nodes;
+}
+
+// Count move as a leaf of the given board, with its kind
+static void countLeaf(const Board *board, Move move, PerftResult *result) {
+	result->nodes++;
+	if (capturedPieceOf(board, move) != EMPTY)
+		result->captures++;
+	if (IS_EN_PASSANT(move))
+		result->enPassants++;
+	if (IS_CASTLING(move))
+		result->castlings++;
+	if (PROMOTED_PIECE(move) != EMPTY)
+		result->promotions++;
+}
+
+// Slower mode that also classifies the last-ply moves, as in the usual perft tables
+// (en passant captures count as captures too)
+void perft_depth(Board *board, int depth, PerftResult *result) {
+	if (depth == 0) {
+		result->nodes++;
+		return;
+	}
+
+	Move moves[MAX_MOVES];
+	int moveCount = generateMoves(board, moves);
+
+	Undo undo;
+	for (int i = 0; i < moveCount; i++) {
+		if (depth == 1) {
+			countLeaf(board, moves[i], result);
+			continue;
+		}
+
+		make_move(board, moves[i], &undo);
+		perft_depth(board, depth - 1, result);
+		unmake_move(board, &undo);
+	}
+}
+
+// Plies below the root at which performPerft still spawns tasks. 1 splits the root
+// moves only; each extra ply multiplies the number of tasks by the branching factor.
+static int perftSplitPlies = 2;
+
+void perft_set_split(int plies) {
+	perftSplitPlies = plies < 1 ? 1 : plies;
+}
+
+// Per-thread work accounting for the summary, one cache line per thread
+typedef struct {
+  uint64_t tasks; // subtrees counted
+  uint64_t nodes; // leaves they held
+  double busy;    // seconds spent counting them
+} __attribute__((aligned(64))) PerftThreadStats;
+
+#define MAX_PERFT_THREADS 256
+static PerftThreadStats threadStats[MAX_PERFT_THREADS];
+static int perftThreads;
+static double perftElapsed;
+
+// Above the split depth every move becomes an OpenMP task working on its own copy
+// of the board; idle threads pick up waiting tasks, so one large subtree no longer
+// leaves the other cores idle at the end. Below it the subtree is counted serially.
+static uint64_t perft_split(const Board *board, int depth, int splitPlies) {
+	Board parent = *board;
+
+	if (splitPlies == 0 || depth < 2) {
+		double start = omp_get_wtime();
+		uint64_t nodes = perft_count(&parent, depth);
+		int thread = omp_get_thread_num();
+		if (thread < MAX_PERFT_THREADS) {
+			threadStats[thread].tasks++;
+			threadStats[thread].nodes += nodes;
+			threadStats[thread].busy += omp_get_wtime() - start;
+		}
+		return nodes;
+	}
+
+	Move moves[MAX_MOVES];
+	uint64_t counts[MAX_MOVES];
+	int moveCount = generateMoves(&parent, moves);
+
+	for (int i = 0; i < moveCount; i++) {
+#pragma omp task shared(parent, moves, counts) firstprivate(i)
+		{
+			Board child = parent;
+			Undo undo;
+			make_move(&child, moves[i], &undo);
+			counts[i] = perft_split(&child, depth - 1, splitPlies - 1);
+		}
+	}
+#pragma omp taskwait
+
+	uint64_t total = 0;
+	for (int i = 0; i < moveCount; i++) {
+		total += counts[i];
+	}
+	return total;
+}
+
+uint64_t performPerft(Game *game, int depth) {
+	uint64_t total = 0;
+	double start = omp_get_wtime();
+	memset(threadStats, 0, sizeof(threadStats));
+
+#pragma omp parallel
+	{
+#pragma omp single
+		{
+			perftThreads = omp_get_num_threads();
+			total = perft_split(&game->board, depth, perftSplitPlies);
+		}
+	}
+
+	perftElapsed = omp_get_wtime() - start;
+	return total;
+}
+
+void perft_print_thread_summary() {
+	int threads = perftThreads < MAX_PERFT_THREADS ? perftThreads : MAX_PERFT_THREADS;
+	for (int i = 0; i < threads; i++) {
+		double utilization = perftElapsed > 0 ? 100.0 * threadStats[i].busy / perftElapsed : 0;
+		printf("info string thread %d: %lu tasks, %lu nodes, busy %.2fs (%.0f%%)\n", i, threadStats[i].tasks, threadStats[i].nodes, threadStats[i].busy,
+			   utilization);
+	}
+	printf("info string %d threads, split %d plies, %.2fs\n", perftThreads, perftSplitPlies, perftElapsed);
+}
+
+static void addResult(PerftResult *total, const PerftResult *result) {
+	total->nodes += result->nodes;
+	total->captures += result->captures;
+	total->enPassants += result->enPassants;
+	total->promotions += result->promotions;
+	total->castlings += result->castlings;
+}
+
+PerftResult performPerftCategories(Game *game, int depth) {
+	PerftResult total = {0, 0, 0, 0, 0};
+	if (depth <= 1) {
+		// The root moves are the leaves
+		Board tempBoard = game->board;
+		perft_depth(&tempBoard, depth, &total);
+		return total;
+	}
+
+	PerftResult results[MAX_MOVES] = {0};
+	Move moves[MAX_MOVES];
+	int moveCount = generateMoves(&game->board, moves);
+
+#pragma omp parallel for
+	for (int i = 0; i < moveCount; i++) {
+		Board tempBoard = game->board;
+		Undo undo;
+		make_move(&tempBoard, moves[i], &undo);
+		perft_depth(&tempBoard, depth - 1, &results[i]);
+	}
+
+	for (int i = 0; i < moveCount; i++) {
+		addResult(&total, &results[i]);
+	}
+	return total;
+}
+
+// One (position, depth) job of an EPD run
+typedef struct {
+  int position; // index into the positions array
+  int depth;
+  uint64_t expected;
+  uint64_t nodes;
+} EpdJob;
+
+// Write s as a JSON string body. FENs only need quotes and backslashes escaped, the
+// error lines may echo arbitrary text, so other control characters become \u escapes.
+static void printJsonString(const char *s) {
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			putchar('\\');
+			putchar(*s);
+		} else if ((unsigned char)*s < 0x20) {
+			printf("\\u%04x", *s);
+		} else {
+			putchar(*s);
+		}
+	}
+}
+
+// Runs every position of an EPD file at depths 1 to maxDepth (0 for MAX_DEPTH) that the
+// line has a "D<depth> <nodes>" field for. Every (position, depth) pair is a job; jobs are
+// spread over the threads deepest first, each counted serially on its own board copy, so
+// small positions keep all cores busy too. Each finished job is printed as a JSON line,
+// followed by a summary line listing the mismatches; errors are JSON lines as well.
+void perftFromEPD(const char *filePath, int maxDepth) {
 	FILE *file = fopen(filePath, "r");
 	if (file == NULL) {
-		printf("Failed to open EPD file: %s\n", filePath);
+		printf("{\"error\":\"failed to open EPD file\",\"file\":\"");
+		printJsonString(filePath);
+		printf("\"}\n");
+		fflush(stdout);
 		return;
 	}
+	if (maxDepth <= 0) {
+		maxDepth = MAX_DEPTH;
+	}
 
-	char line[256];
-	Game game;
+	// Read the whole file first; getline copes with lines of any length
+	char **fens = NULL;
+	int *lineNumbers = NULL;
+	EpdJob *jobs = NULL;
+	int positionCount = 0, positionCapacity = 0;
+	int jobCount = 0, jobCapacity = 0;
+	char *line = NULL;
+	size_t lineSize = 0;
 	int linecount = 0;
-	int matchcount = 0;
-	while (fgets(line, sizeof(line), file)) {
+
+	while (getline(&line, &lineSize, file) != -1) {
 		linecount++;
 
 		// Add this check for blank lines
@@ -42,90 +326,137 @@ void perftFromEPD(const char *filePath) {
 
 		char *fenEnd = strchr(line, ';');
 		if (fenEnd == NULL) {
-			printf("Invalid EPD line: %s\n", line);
+			line[strcspn(line, "\r\n")] = '\0';
+			printf("{\"error\":\"invalid EPD line\",\"line\":%d,\"text\":\"", linecount);
+			printJsonString(line);
+			printf("\"}\n");
 			continue;
 		}
-
+		char *perftResults = fenEnd + 1; // Start from the next character after the ';'
+		while (fenEnd > line && fenEnd[-1] == ' ') {
+			fenEnd--;
+		}
 		*fenEnd = '\0';
-		setBoardtoFEN(&game.board, line);
-		// printBoard(&game.board);
 
-		char *perftResults = fenEnd + 1; // Start from the next character after the ';'
+		if (positionCount == positionCapacity) {
+			positionCapacity = positionCapacity ? positionCapacity * 2 : 256;
+			fens = realloc(fens, positionCapacity * sizeof(*fens));
+			lineNumbers = realloc(lineNumbers, positionCapacity * sizeof(*lineNumbers));
+		}
+		fens[positionCount] = strdup(line);
+		lineNumbers[positionCount] = linecount;
 
-		for (int depth = 1; depth <= MAX_DEPTH; depth++) {
-			uint64_t expectedNodes = parseDepthResult(perftResults, depth);
-
-			uint64_t result = performPerft(&game, depth);
-			if (result != expectedNodes) {
-				printf("Mismatch in perft result for FEN: %s\n", line);
-				printf("Depth: %d, expected: %lu, got: %lu\n", depth, expectedNodes, result);
-			} else {
-				matchcount++;
-				if (matchcount % 100 == 0) 
-					printf("Matches so far %d \n",matchcount);
-				// printf("Matched %d", linecount);
-				// printf("Depth: %d, expected: %lu, got: %lu\n", depth,
-				// expectedNodes, result);
+		for (int depth = 1; depth <= maxDepth; depth++) {
+			char depthStr[16];
+			sprintf(depthStr, "D%d ", depth);
+			if (strstr(perftResults, depthStr) == NULL) {
+				continue;
 			}
+			if (jobCount == jobCapacity) {
+				jobCapacity = jobCapacity ? jobCapacity * 2 : 1024;
+				jobs = realloc(jobs, jobCapacity * sizeof(*jobs));
+			}
+			jobs[jobCount++] = (EpdJob){positionCount, depth, parseDepthResult(perftResults, depth), 0};
 		}
+		positionCount++;
 	}
+	free(line);
 	fclose(file);
-	printf("Matches: %d\n", matchcount);
-	matchcount = 0;
-}
 
-void perft_depth(Board *board, int depth, PerftResult *result) {
-	if (depth == 0) {
-		result->nodes++;
-		return;
+	// Deepest jobs first so the big ones don't start last and leave a tail
+	EpdJob *sorted = malloc((jobCount ? jobCount : 1) * sizeof(*sorted));
+	int sortedCount = 0;
+	for (int depth = maxDepth; depth >= 1; depth--) {
+		for (int i = 0; i < jobCount; i++) {
+			if (jobs[i].depth == depth) {
+				sorted[sortedCount++] = jobs[i];
+			}
+		}
 	}
 
-	Move moves[MAX_MOVES];
-	int moveCount = generateMoves(board, moves);
+	double start = omp_get_wtime();
 
-	for (int i = 0; i < moveCount; i++) {
-		Board tempBoard = *board;
-		make_move(&tempBoard, moves[i]);
-		PerftResult child_result = {0, 0, 0, 0, 0};
-		perft_depth(&tempBoard, depth - 1, &child_result);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < sortedCount; i++) {
+		EpdJob *job = &sorted[i];
+		Board board;
+		setBoardtoFEN(&board, fens[job->position]);
+
+		double jobStart = omp_get_wtime();
+		job->nodes = perft_count(&board, job->depth);
+		double seconds = omp_get_wtime() - jobStart;
+
+#pragma omp critical(epdOutput)
+		{
+			printf("{\"line\":%d,\"fen\":\"", lineNumbers[job->position]);
+			printJsonString(fens[job->position]);
+			printf("\",\"depth\":%d,\"expected\":%lu,\"nodes\":%lu,\"ok\":%s,\"ms\":%.3f,\"nps\":%.0f}\n", job->depth, job->expected, job->nodes,
+				   job->nodes == job->expected ? "true" : "false", seconds * 1000, seconds > 0 ? job->nodes / seconds : 0);
+			fflush(stdout);
+		}
+	}
+
+	double seconds = omp_get_wtime() - start;
+	uint64_t totalNodes = 0;
+	int matchcount = 0;
+	for (int i = 0; i < sortedCount; i++) {
+		totalNodes += sorted[i].nodes;
+		matchcount += sorted[i].nodes == sorted[i].expected;
+	}
 
-		if (CAPTURED_PIECE(moves[i]) != EMPTY)
-			child_result.captures++;
-		if (IS_EN_PASSANT(moves[i]))
-			child_result.enPassants++;
-		if (IS_CASTLING(moves[i]))
-			child_result.castlings++;
-		if (PROMOTED_PIECE(moves[i]) != EMPTY)
-			child_result.promotions++;
+	printf("{\"summary\":{\"positions\":%d,\"jobs\":%d,\"matches\":%d,\"mismatches\":%d,\"nodes\":%lu,\"seconds\":%.3f,\"nps\":%.0f,\"failed\":[",
+		   positionCount, sortedCount, matchcount, sortedCount - matchcount, totalNodes, seconds, seconds > 0 ? totalNodes / seconds : 0);
+	int first = 1;
+	for (int i = 0; i < sortedCount; i++) {
+		if (sorted[i].nodes != sorted[i].expected) {
+			printf("%s{\"line\":%d,\"depth\":%d,\"expected\":%lu,\"nodes\":%lu}", first ? "" : ",", lineNumbers[sorted[i].position], sorted[i].depth,
+				   sorted[i].expected, sorted[i].nodes);
+			first = 0;
+		}
+	}
+	printf("]}}\n");
+	fflush(stdout);
 
-		result->nodes += child_result.nodes;
-		result->captures += child_result.captures;
-		result->enPassants += child_result.enPassants;
-		result->promotions += child_result.promotions;
-		result->castlings += child_result.castlings;
+	for (int i = 0; i < positionCount; i++) {
+		free(fens[i]);
 	}
+	free(fens);
+	free(lineNumbers);
+	free(jobs);
+	free(sorted);
 }
 
-uint64_t performPerft(Game *game, int depth) {
-	time_t start_time = time(NULL);
+void perftDivide(Game *game, int depth) {
 	PerftResult results[MAX_MOVES] = {0};
 	Move moves[MAX_MOVES];
 	int moveCount = generateMoves(&game->board, moves);
+	double start = omp_get_wtime();
 
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic, 1)
 	for (int i = 0; i < moveCount; i++) {
+		if (depth == 1) {
+			// The root moves are the leaves
+			countLeaf(&game->board, moves[i], &results[i]);
+			continue;
+		}
 		Board tempBoard = game->board;
-		make_move(&tempBoard, moves[i]);
+		Undo undo;
+		make_move(&tempBoard, moves[i], &undo);
 		perft_depth(&tempBoard, depth - 1, &results[i]);
 	}
 
+	double seconds = omp_get_wtime() - start;
 	PerftResult total = {0, 0, 0, 0, 0};
 	for (int i = 0; i < moveCount; i++) {
-		total.nodes += results[i].nodes;
+		char moveStr[6] = {0};
+		moveToUCI(moves[i], moveStr);
+		printf("%s: %lu\n", moveStr, results[i].nodes);
+		addResult(&total, &results[i]);
 	}
 
-	time_t end_time = time(NULL);
-	int elapsed_time = difftime(end_time, start_time);
-	//printf("info string elapsed time %d seconds.\n", elapsed_time);
-	return total.nodes;
+	printf("info string Moves: %d, nodes: %lu\n", moveCount, total.nodes);
+	printf("info string Captures: %lu, en passant: %lu, castles: %lu, promotions: %lu\n", total.captures, total.enPassants, total.castlings,
+		   total.promotions);
+	printf("info string Time: %.3fs, nps: %.0f\n", seconds, seconds > 0 ? total.nodes / seconds : 0);
+	fflush(stdout);
 }
@@ -1,6 +1,7 @@
 #ifndef PERFT_H
 #define PERFT_H
 
+#include <stddef.h>
 #include "game.h"
 
 typedef struct {
@@ -11,7 +12,19 @@ typedef struct {
   uint64_t castlings;
 } PerftResult;
 
+// Leaf count, bulk-counted at the last ply
 uint64_t performPerft(Game *game, int depth);
-void perftFromEPD(const char *filePath);
+// Size the perft hash table used by performPerft, 0 turns it off (the default)
+void perft_set_hash(size_t megabytes);
+// Spawn tasks for the moves of the first plies plies (default 2)
+void perft_set_split(int plies);
+// Per-thread tasks, nodes and busy time of the last performPerft
+void perft_print_thread_summary();
+// Leaf count plus the kinds of last-ply moves; slower
+PerftResult performPerftCategories(Game *game, int depth);
+// Node count and kinds of last-ply moves per root move, with totals, time and nps
+void perftDivide(Game *game, int depth);
+// Check an EPD perft suite up to maxDepth (0 for the default 4), printing JSON lines
+void perftFromEPD(const char *filePath, int maxDepth);
 
 #endif
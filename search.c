@@ -1,82 +1,895 @@
+#include <math.h>
 #include <omp.h>
 #include <stdio.h>
-#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "search.h"
 #include "attacked.h"
 #include "board.h" // Assuming that this file contains the generateMoves and make_move functions
 #include "evaluate.h"
 #include "move.h"
+#include "movepicker.h"
+#include "tt.h"
 #include "uci.h"
 
+// Mate scores count plies from the root: mated here scores -MATE_SCORE + ply.
+// Anything beyond MATE_BOUND is a mate score.
+#define MATE_SCORE 100000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+
+#define MAX_THREADS 256
+
+// A thread waiting at a split point runs other tasks, so its tasks nest; this many scratch games are kept
+#define SPARE_GAMES 16
+
+// Per-thread search state, on its own cache lines so the node counters don't bounce between cores.
+// The move ordering tables live here too: each thread learns from its own part of the tree.
+typedef struct {
+	Move killers[MAX_PLY][2]; // two most recent quiet moves that caused a beta cut-off, per ply
+	Move counterMoves[7][64]; // quiet move that refuted the previous move, by its piece type and destination
+	int history[2][64][64];	  // butterfly history: [side][from][to], how well a quiet move has been cutting off
+	Move pv[MAX_PLY][MAX_PLY]; // triangular PV table: pv[ply] is the best line found from the node at ply
+	int pvLength[MAX_PLY];
+	Game *spareGames[SPARE_GAMES]; // aligned scratch games for YBWC tasks, kept across tasks and searches
+	int spareGameCount;
+	unsigned long long nodes;
+	int id; // 0 is the main thread, the others are Lazy SMP helpers
+} __attribute__((aligned(64))) SearchData;
+
+// History scores stay within +-HISTORY_MAX
+#define HISTORY_MAX 16384
+
 // Global variable for node count
 unsigned long long nodeCount = 0;
+int quitRequested = 0;
+
+static int searchThreads = 1;
+static int searchMode = SEARCH_LAZY_SMP;
+// Kept between searches so history and countermoves carry over to the next move
+static SearchData searchData[MAX_THREADS];
+static int activeThreads;
+
+// Limits of the current search, shared by all threads. Deadlines are seconds after searchStart, 0 for none.
+static double searchStart;
+static double softDeadline;
+static double hardDeadline;
+static unsigned long long nodeLimit;
+static int watchInput;	   // read stop, quit and isready from stdin while searching
+static int infiniteSearch; // go infinite, only stop or quit end it
+static volatile int stopSearch;
+
+// Handle the commands that arrive while searching. Only called from one thread at a time.
+static void pollInput() {
+	char line[256];
+	int status;
+	while ((status = uciSearchCommand(line, sizeof(line))) > 0) {
+		if (strncmp(line, "stop", 4) == 0) {
+			stopSearch = 1;
+		} else if (strncmp(line, "quit", 4) == 0) {
+			quitRequested = 1;
+			stopSearch = 1;
+		} else {
+			printf("readyok\n");
+			fflush(stdout);
+		}
+	}
+	if (status < 0) {
+		// The GUI went away: finish this search and quit. Only go infinite would never end.
+		quitRequested = 1;
+		if (infiniteSearch) {
+			stopSearch = 1;
+		}
+	}
+}
+
+// Nodes of all threads so far; the counts are read racily, close enough for limits and reports
+static unsigned long long totalNodes() {
+	unsigned long long nodes = 0;
+	for (int i = 0; i < activeThreads; i++) {
+		nodes += searchData[i].nodes;
+	}
+	return nodes;
+}
+
+static void checkLimits(const SearchData *data) {
+	if ((hardDeadline > 0 && omp_get_wtime() - searchStart >= hardDeadline) || (nodeLimit > 0 && totalNodes() >= nodeLimit)) {
+		stopSearch = 1;
+	}
+	if (watchInput && data->id == 0) {
+		pollInput();
+	}
+}
+
+// Count a node, every 1024th also checks the limits. Returns nonzero once the search has to stop.
+static inline int countNode(SearchData *data) {
+	if ((++data->nodes & 1023) == 0) {
+		checkLimits(data);
+	}
+	return stopSearch;
+}
+
+void search_set_mode(int mode) {
+	searchMode = mode;
+}
+
+void search_set_threads(int threads) {
+	searchThreads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+int search_threads() {
+	return searchThreads;
+}
+
+void search_clear() {
+	for (int i = 0; i < MAX_THREADS; i++) {
+		for (int j = 0; j < searchData[i].spareGameCount; j++) {
+			free(searchData[i].spareGames[j]);
+		}
+	}
+	memset(searchData, 0, sizeof(searchData));
+}
+
+// Remember a quiet move that caused a beta cut-off, keeping the previous one as second killer
+static void updateKillers(SearchData *data, int ply, Move move) {
+	if (ply < MAX_PLY && data->killers[ply][0] != move) {
+		data->killers[ply][1] = data->killers[ply][0];
+		data->killers[ply][0] = move;
+	}
+}
+
+// Move an entry towards +-HISTORY_MAX; the closer it already is, the smaller the step
+static void updateHistoryEntry(int *entry, int bonus) {
+	*entry += bonus - *entry * (bonus < 0 ? -bonus : bonus) / HISTORY_MAX;
+}
+
+// A quiet move cut off: reward it, penalize the quiet moves tried before it, and make it
+// the countermove to the move that led here
+static void updateQuietHistory(Game *game, SearchData *data, int depth, Move move, const Move *triedQuiets, int triedCount) {
+	int side = game->board.sideToMove;
+	int bonus = depth * depth < 1200 ? depth * depth : 1200;
+	updateHistoryEntry(&data->history[side][FROM_SQUARE(move)][TO_SQUARE(move)], bonus);
+	for (int i = 0; i < triedCount; i++) {
+		if (triedQuiets[i] != move) {
+			updateHistoryEntry(&data->history[side][FROM_SQUARE(triedQuiets[i])][TO_SQUARE(triedQuiets[i])], -bonus);
+		}
+	}
+
+	if (game->positionHistoryLength > 1) {
+		const Undo *last = &game->undoStack[game->positionHistoryLength - 1];
+		data->counterMoves[last->movedPiece][TO_SQUARE(last->move)] = move;
+	}
+}
+
+// YBWC split point: the node's younger brothers run as tasks sharing its window and result
+typedef struct SplitPoint {
+	const struct SplitPoint *parent; // enclosing split point, whose cutoff aborts this one too
+	int alpha;
+	int beta;
+	int bestScore;
+	Move bestMove;
+	volatile int cutoff; // set once a move fails high, the remaining tasks give up
+	Move pv[MAX_PLY];	 // best line from the split node, the tasks run on other threads' PV tables
+	int pvLength;
+} SplitPoint;
+
+// Only nodes with this much depth left are worth a split's task and game copies
+#define SPLIT_MIN_DEPTH 4
+
+// Whether this split point or any enclosing one has failed high
+static int splitAborted(const SplitPoint *split) {
+	for (; split != NULL; split = split->parent) {
+		if (split->cutoff) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// The table stores mate scores relative to the node, not the root, so a mate
+// found through a transposition at another ply still counts the right distance
+static int scoreToTT(int score, int ply) {
+	return score >= MATE_BOUND ? score + ply : score <= -MATE_BOUND ? score - ply : score;
+}
+
+static int scoreFromTT(int score, int ply) {
+	return score >= MATE_BOUND ? score - ply : score <= -MATE_BOUND ? score + ply : score;
+}
+
+// Triangular PV: a node's line is its best move followed by the child's line
+static void updatePv(SearchData *data, int ply, Move move) {
+	if (ply + 1 >= MAX_PLY) {
+		return;
+	}
+	data->pv[ply][0] = move;
+	memcpy(&data->pv[ply][1], data->pv[ply + 1], data->pvLength[ply + 1] * sizeof(Move));
+	data->pvLength[ply] = data->pvLength[ply + 1] + 1;
+}
+
+// A capture is skipped in quiescence when even winning the piece plus this
+// margin can't lift the static evaluation up to alpha
+#define DELTA_MARGIN 200
+
+// Quiescence search: at the horizon keep resolving captures and promotions until
+// the position is quiet, so a hanging piece isn't misjudged by the static evaluation.
+// Works on the board alone; repetitions can't occur through captures.
+int quiescence(Board *board, SearchData *data, int ply, int alpha, int beta) {
+	// Lines end here, captures aren't part of the reported PV
+	if (ply < MAX_PLY) {
+		data->pvLength[ply] = 0;
+	}
+	if (countNode(data)) {
+		return 0;
+	}
+
+	int kingSquare = __builtin_ctzll(board->bb[board->sideToMove][KING]);
+	int inCheck = is_square_attacked(board, kingSquare);
+	int standPat = evaluate(board);
+	MovePicker picker;
+
+	if (inCheck) {
+		// No standing pat in check: every evasion has to be tried
+		initMovePicker(&picker, board, 0, NULL, 0, NULL);
+	} else {
+		// Stand pat: the side to move can usually do at least as well as the static evaluation
+		if (standPat >= beta) {
+			return standPat;
+		}
+		if (standPat > alpha) {
+			alpha = standPat;
+		}
+		initCapturePicker(&picker, board);
+	}
+
+	int bestScore = inCheck ? -1000000 : standPat;
+	int movesSearched = 0;
+	Move move;
+	while ((move = nextMove(&picker)) != 0) {
+		movesSearched++;
+
+		// Delta pruning
+		if (!inCheck && standPat + pieceValues[capturedPieceOf(board, move)] + pieceValues[PROMOTED_PIECE(move)] + DELTA_MARGIN <= alpha) {
+			continue;
+		}
+
+		Undo undo;
+		make_move(board, move, &undo);
+		int score = -quiescence(board, data, ply + 1, -beta, -alpha);
+		unmake_move(board, &undo);
+
+		bestScore = (score > bestScore) ? score : bestScore;
+		alpha = (score > alpha) ? score : alpha;
+		if (alpha >= beta) {
+			break;
+		}
+	}
+
+	// Checkmate
+	if (inCheck && movesSearched == 0) {
+		return -MATE_SCORE + ply;
+	}
+
+	return bestScore;
+}
+
+// Selective search, each part switchable from UCI so it can be measured on its own
+static int useNullMove = 1;
+static int useLmr = 1;
+static int useFutility = 1;
+static int useReverseFutility = 1;
+static int useLateMovePruning = 1;
+
+static const struct {
+	const char *name;
+	int *enabled;
+} searchOptions[] = {
+	{"NullMove", &useNullMove}, {"LMR", &useLmr}, {"Futility", &useFutility}, {"ReverseFutility", &useReverseFutility}, {"LateMovePruning", &useLateMovePruning},
+};
+
+#define SEARCH_OPTIONS (int)(sizeof(searchOptions) / sizeof(searchOptions[0]))
+
+const char *search_option_name(int index) {
+	return index >= 0 && index < SEARCH_OPTIONS ? searchOptions[index].name : NULL;
+}
+
+int search_set_option(const char *name, int enabled) {
+	for (int i = 0; i < SEARCH_OPTIONS; i++) {
+		if (strcmp(name, searchOptions[i].name) == 0) {
+			*searchOptions[i].enabled = enabled;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Reverse futility: this far above beta at low depth, assume the opponent can't catch up
+#define RFP_MAX_DEPTH 6
+#define RFP_MARGIN 90
+// Futility: this far below alpha near the horizon, a quiet move won't make up the difference
+#define FUTILITY_MAX_DEPTH 3
+#define FUTILITY_MARGIN 120
+// Late-move pruning: after this many quiet moves near the horizon, skip the rest
+#define LMP_MAX_DEPTH 3
+#define LMP_BASE 4
+
+// Late-move reductions by remaining depth and move number, log-log shaped
+static int lmrTable[64][64];
+
+void init_search() {
+	for (int depth = 1; depth < 64; depth++) {
+		for (int moveNumber = 1; moveNumber < 64; moveNumber++) {
+			lmrTable[depth][moveNumber] = (int)(0.75 + log(depth) * log(moveNumber) / 2.25);
+		}
+	}
+}
+
+// The side to move has something besides pawns and the king, so passing is
+// unlikely to be its best option (zugzwang guard for the null move)
+static int hasNonPawnMaterial(const Board *board, int side) {
+	return (board->bb[side][ALL_PIECES] & ~board->bb[side][PAWN] & ~board->bb[side][KING]) != 0;
+}
+
+// Futility and late-move pruning of a quiet move. Never the first move, so the node
+// always has a real score, and nothing in check or while getting mated.
+static int pruneQuiet(int depth, int inCheck, int futile, int moveNumber, int quietNumber, int bestScore) {
+	if (inCheck || moveNumber == 1 || bestScore <= -MATE_BOUND) {
+		return 0;
+	}
+	if (useFutility && futile) {
+		return 1;
+	}
+	return useLateMovePruning && depth <= LMP_MAX_DEPTH && quietNumber > LMP_BASE + depth * depth;
+}
+
+int dfs(Game *game, SearchData *data, int depth, int ply, int alpha, int beta, const SplitPoint *split);
+static int searchSplit(Game *game, MovePicker *picker, SplitPoint *sp, int depth, int ply, int inCheck, int futile, int quietsSeen);
+
+// Make move, search it and take it back. Principal variation search: only the first
+// move gets the full window, the others a null window proving they are no better,
+// re-searched in full only when they are. Late quiet moves are first tried reduced.
+static int searchMove(Game *game, SearchData *data, Move move, int depth, int ply, int alpha, int beta, int moveNumber, int quiet, int inCheck,
+					  const SplitPoint *split) {
+	game_make_move(game, move);
+	tt_prefetch(game->board.zobristKey);
+
+	int score;
+	int reduction = 0;
+	if (useLmr && depth >= 3 && moveNumber > 3 && quiet && !inCheck) {
+		// Checking moves are searched in full
+		int kingSquare = __builtin_ctzll(game->board.bb[game->board.sideToMove][KING]);
+		if (!is_square_attacked(&game->board, kingSquare)) {
+			reduction = lmrTable[depth < 64 ? depth : 63][moveNumber < 64 ? moveNumber : 63];
+			reduction = reduction < depth - 1 ? reduction : depth - 2;
+		}
+	}
+	if (moveNumber == 1) {
+		score = -dfs(game, data, depth - 1, ply + 1, -beta, -alpha, split);
+	} else {
+		score = -dfs(game, data, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha, split);
+		if (score > alpha && reduction > 0) {
+			score = -dfs(game, data, depth - 1, ply + 1, -alpha - 1, -alpha, split);
+		}
+		if (score > alpha && score < beta) {
+			score = -dfs(game, data, depth - 1, ply + 1, -beta, -alpha, split);
+		}
+	}
+
+	game_unmake_move(game);
+	return score;
+}
 
 // Recursive depth-first search function with alpha-beta pruning
-int dfs(Game *game, int depth, int alpha, int beta) {
-#pragma omp atomic
-        nodeCount++;
+int dfs(Game *game, SearchData *data, int depth, int ply, int alpha, int beta, const SplitPoint *split) {
+    // At the horizon, resolve captures before trusting the evaluation
+    if (depth <= 0) {
+		return quiescence(&game->board, data, ply, alpha, beta);
+    }
 
-    // If we've reached the maximum depth, return the static evaluation score
-    if (depth == 0) {
-		return evaluate(&game->board);
+    if (ply < MAX_PLY) {
+        data->pvLength[ply] = 0;
+    }
+    if (countNode(data) || splitAborted(split)) {
+        return 0;
     }
 
-	// Check if the position is a repeated position
+    // Nodes with an open window are on the principal variation, the rest only have to prove a bound
+    int pvNode = beta - alpha > 1;
+
+	// Check if the position is a repeated position. Positions before a null move
+	// can't really repeat: the side that passed never got to play that line.
 	int repeatedcount = 0;
-    for (int i = 0; i < game->positionHistoryLength - 1; i++) {
+    for (int i = game->positionHistoryLength - 2; i >= 0; i--) {
+        if (game->undoStack[i + 1].move == 0)
+			break;
         if (game->board.zobristKey == game->positionHistory[i])
 			repeatedcount++;
         if (repeatedcount > 1)
 			return 100;
 	}
 
-    // Generate all legal moves
-    Move moveList[MAX_MOVES];
-    int moveCount = generateMoves(&game->board, moveList);
+    // A deep enough entry whose bound settles the window ends the search here, except
+    // on the PV where that would cut the reported line short; any entry still gives
+    // the best move to try first
+    uint64_t key = game->board.zobristKey;
+    Move ttMove = 0;
+    TTHit hit;
+    if (tt_probe(key, &hit)) {
+        ttMove = hit.move;
+        int ttScore = scoreFromTT(hit.score, ply);
+        if (!pvNode && hit.depth >= depth && (hit.bound == TT_EXACT || (hit.bound == TT_LOWER && ttScore >= beta) || (hit.bound == TT_UPPER && ttScore <= alpha))) {
+            return ttScore;
+        }
+    }
 
-    // If there are no legal moves, this is a checkmate or stalemate.
-    if (moveCount == 0) {
-        int kingSquare = __builtin_ffsll(game->board.kings[game->board.sideToMove]) - 1;
-        if (is_square_attacked(&game->board, kingSquare)) {
-            // The king of the current side to move is in check, so this is a  checkmate
-            return -100000-depth;
-        } else {
-            // The king is not in check, so this is a stalemate
-            return 0; // or some other score that represents a draw
+    int side = game->board.sideToMove;
+    int inCheck = is_square_attacked(&game->board, __builtin_ctzll(game->board.bb[side][KING]));
+    int staticEval = inCheck ? 0 : evaluate(&game->board);
+
+    // Pruning on the static evaluation, never on the PV, in check or around mate scores
+    if (!pvNode && !inCheck && beta < MATE_BOUND && beta > -MATE_BOUND) {
+        if (useReverseFutility && depth <= RFP_MAX_DEPTH && staticEval - RFP_MARGIN * depth >= beta) {
+            return staticEval;
+        }
+
+        // Null move: if passing still fails high after a reduced search, a real move will too.
+        // Not twice in a row, and not with only pawns left, where passing may be the best move.
+        int lastMoveWasNull = game->positionHistoryLength > 1 && game->undoStack[game->positionHistoryLength - 1].move == 0;
+        if (useNullMove && depth >= 3 && staticEval >= beta && !lastMoveWasNull && hasNonPawnMaterial(&game->board, side)) {
+            game_make_null_move(game);
+            int score = -dfs(game, data, depth - 4 - depth / 6, ply + 1, -beta, -beta + 1, split);
+            game_unmake_null_move(game);
+            if (stopSearch || splitAborted(split)) {
+                return 0;
+            }
+            if (score >= beta) {
+                // An unproven mate from a null move search isn't trusted
+                return score >= MATE_BOUND ? beta : score;
+            }
         }
     }
+    int futile = !inCheck && depth <= FUTILITY_MAX_DEPTH && alpha > -MATE_BOUND && alpha < MATE_BOUND && staticEval + FUTILITY_MARGIN * depth <= alpha;
+
+    // Moves come from the picker stage by stage, so a cut-off on an early move
+    // saves generating the rest
+    Move counterMove = 0;
+    if (game->positionHistoryLength > 1) {
+        const Undo *last = &game->undoStack[game->positionHistoryLength - 1];
+        counterMove = data->counterMoves[last->movedPiece][TO_SQUARE(last->move)];
+    }
+    MovePicker picker;
+    initMovePicker(&picker, &game->board, ttMove, ply < MAX_PLY ? data->killers[ply] : NULL, counterMove,
+                   (const int(*)[64])data->history[side]);
 
     // For each legal move, make that move, then recursively search the resulting position. Keep track of the best score found.
     int bestScore = -1000000;
-    for (int i = 0; i < moveCount; i++) {
-        // Make a copy of the game and make the move on the copy
-        Game tempGame = *game;
-        game_make_move(&tempGame, moveList[i]);
+    Move bestMove = 0;
+    int originalAlpha = alpha;
+    int movesSearched = 0;
+    int quietsSeen = 0;
+    Move triedQuiets[64];
+    int triedCount = 0;
+    Move move;
+    while ((move = nextMove(&picker)) != 0) {
+        movesSearched++;
+        int quiet = isQuietMove(&game->board, move);
+        quietsSeen += quiet;
+        if (quiet && pruneQuiet(depth, inCheck, futile, movesSearched, quietsSeen, bestScore)) {
+            continue;
+        }
 
-        // Recursively search the resulting position
-        int score = -dfs(&tempGame, depth - 1, -beta, -alpha);
+        int score = searchMove(game, data, move, depth, ply, alpha, beta, movesSearched, quiet, inCheck, split);
 
         // If this score is the best so far, update bestScore
-        bestScore = (score > bestScore) ? score : bestScore;
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = move;
+        }
 
         // Alpha-beta pruning condition
-        alpha = (score > alpha) ? score : alpha;
+        if (score > alpha) {
+            alpha = score;
+            updatePv(data, ply, move);
+        }
         if (alpha >= beta) {
+            if (quiet) {
+                updateKillers(data, ply, move);
+                updateQuietHistory(game, data, depth, move, triedQuiets, triedCount);
+            }
             break; // beta cut-off
         }
+        if (quiet && triedCount < 64) {
+            triedQuiets[triedCount++] = move;
+        }
+
+        // Young Brothers Wait: the eldest brother is searched and failed to cut off,
+        // now the younger ones can go to idle threads
+        if (searchMode == SEARCH_YBWC && activeThreads > 1 && depth >= SPLIT_MIN_DEPTH) {
+            SplitPoint sp = {split, alpha, beta, bestScore, bestMove, 0, {0}, 0};
+            if (ply < MAX_PLY) {
+                sp.pvLength = data->pvLength[ply];
+                memcpy(sp.pv, data->pv[ply], sp.pvLength * sizeof(Move));
+            }
+            movesSearched += searchSplit(game, &picker, &sp, depth, ply, inCheck, futile, quietsSeen);
+            bestScore = sp.bestScore;
+            bestMove = sp.bestMove;
+            // Tasks other nodes ran on this thread meanwhile may have overwritten the PV rows
+            if (ply < MAX_PLY) {
+                data->pvLength[ply] = sp.pvLength;
+                memcpy(data->pv[ply], sp.pv, sp.pvLength * sizeof(Move));
+            }
+            if (sp.cutoff && isQuietMove(&game->board, bestMove)) {
+                updateKillers(data, ply, bestMove);
+                updateQuietHistory(game, data, depth, bestMove, triedQuiets, triedCount);
+            }
+            break;
+        }
     }
 
+    // The scores of an aborted search are meaningless, keep them out of the table
+    if (stopSearch || splitAborted(split)) {
+        return 0;
+    }
+
+    // If there are no legal moves, this is a checkmate or stalemate.
+    if (movesSearched == 0) {
+        if (inCheck) {
+            // The king of the current side to move is in check, so this is a  checkmate
+            return -MATE_SCORE + ply;
+        } else {
+            // The king is not in check, so this is a stalemate
+            return 0; // or some other score that represents a draw
+        }
+    }
+
+    // A fail-low's best move is no better than the others, keep whatever move the entry had
+    int bound = bestScore >= beta ? TT_LOWER : bestScore > originalAlpha ? TT_EXACT : TT_UPPER;
+    tt_store(key, bound == TT_UPPER ? 0 : bestMove, depth, bound, scoreToTT(bestScore, ply));
+
     // After searching all moves, return the best score found
     return bestScore;
 }
 
+// Limits from the go command, 0 when not given; times in milliseconds
+typedef struct {
+	int depth;
+	unsigned long long nodes;
+	int movetime;
+	int time[2];
+	int inc[2];
+	int movestogo;
+	int infinite;
+} SearchLimits;
+
+// Tokens that take a value consume it; anything else (go, ponder, searchmoves and its moves) is skipped
+static void parseGoCommand(const char *goCommand, SearchLimits *limits) {
+	struct {
+		const char *name;
+		int *field;
+	} fields[] = {
+		{"depth", &limits->depth}, {"movetime", &limits->movetime}, {"movestogo", &limits->movestogo},
+		{"wtime", &limits->time[WHITE]}, {"btime", &limits->time[BLACK]},
+		{"winc", &limits->inc[WHITE]}, {"binc", &limits->inc[BLACK]},
+	};
+
+	char *copy = strdup(goCommand);
+	char *save = NULL;
+	for (char *token = strtok_r(copy, " ", &save); token != NULL; token = strtok_r(NULL, " ", &save)) {
+		if (strcmp(token, "infinite") == 0) {
+			limits->infinite = 1;
+			continue;
+		}
+		int *field = NULL;
+		for (int i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) {
+			if (strcmp(token, fields[i].name) == 0) {
+				field = fields[i].field;
+			}
+		}
+		if (field != NULL || strcmp(token, "nodes") == 0) {
+			char *value = strtok_r(NULL, " ", &save);
+			if (value == NULL) {
+				break;
+			}
+			if (field != NULL) {
+				*field = atoi(value);
+			} else {
+				limits->nodes = strtoull(value, NULL, 10);
+			}
+		}
+	}
+	free(copy);
+}
+
+// Kept back from the clock for the GUI and the operating system
+#define MOVE_OVERHEAD_MS 30
+// Without movestogo, assume the game lasts this many more moves
+#define DEFAULT_MOVES_TO_GO 30
+
+// Soft: don't start another iteration past half of it. Hard: abort the iteration in progress.
+// movetime only has a hard deadline; with no clock left to save for, it uses all of it.
+static void allocateTime(const SearchLimits *limits, int side) {
+	softDeadline = hardDeadline = 0;
+	if (limits->movetime > 0) {
+		int budget = limits->movetime > MOVE_OVERHEAD_MS ? limits->movetime - MOVE_OVERHEAD_MS : 1;
+		hardDeadline = budget / 1000.0;
+	} else if (limits->time[side] > 0) {
+		int movesToGo = limits->movestogo > 0 ? limits->movestogo : DEFAULT_MOVES_TO_GO;
+		double available = limits->time[side] > MOVE_OVERHEAD_MS ? limits->time[side] - MOVE_OVERHEAD_MS : 1;
+		double soft = available / movesToGo + limits->inc[side] * 3 / 4;
+		double hard = soft * 4 < available * 0.8 ? soft * 4 : available * 0.8;
+		softDeadline = (soft < hard ? soft : hard) / 1000.0;
+		hardDeadline = hard / 1000.0;
+	}
+}
+
+// Scratch game for a task on this thread, from its spares when there is one. Tasks are tied,
+// so the game goes back to the same thread's spares.
+static Game *takeSpareGame(SearchData *data) {
+	if (data->spareGameCount > 0) {
+		return data->spareGames[--data->spareGameCount];
+	}
+	return aligned_alloc(64, sizeof(Game));
+}
+
+static void returnSpareGame(SearchData *data, Game *game) {
+	if (data->spareGameCount < SPARE_GAMES) {
+		data->spareGames[data->spareGameCount++] = game;
+	} else {
+		free(game);
+	}
+}
+
+// One younger brother of a split point, run as a task by whichever thread picks it up
+static void searchSplitMove(const Game *game, SplitPoint *sp, Move move, int depth, int ply, int moveNumber, int quiet, int inCheck) {
+	if (stopSearch || splitAborted(sp)) {
+		return;
+	}
+
+	// The parent's game stays untouched until every task has finished
+	SearchData *data = &searchData[omp_get_thread_num()];
+	Game *child = takeSpareGame(data);
+	game_copy(child, game);
+	int alpha = __atomic_load_n(&sp->alpha, __ATOMIC_RELAXED);
+	int score = searchMove(child, data, move, depth, ply, alpha, sp->beta, moveNumber, quiet, inCheck, sp);
+	returnSpareGame(data, child);
+
+	if (stopSearch || splitAborted(sp)) {
+		return;
+	}
+#pragma omp critical(splitpoint)
+	{
+		if (score > sp->bestScore) {
+			sp->bestScore = score;
+			sp->bestMove = move;
+		}
+		if (score > sp->alpha) {
+			__atomic_store_n(&sp->alpha, score, __ATOMIC_RELAXED);
+			// The child's line is still in this thread's table, nothing ran in between
+			int childLength = ply + 1 < MAX_PLY ? data->pvLength[ply + 1] : 0;
+			sp->pv[0] = move;
+			memcpy(&sp->pv[1], data->pv[ply + 1], childLength * sizeof(Move));
+			sp->pvLength = childLength + 1;
+		}
+		if (sp->alpha >= sp->beta) {
+			sp->cutoff = 1;
+		}
+	}
+}
+
+// Hand the picker's remaining moves out as tasks and wait for all of them, pruning
+// the same moves the serial loop would. Returns the number of moves.
+static int searchSplit(Game *game, MovePicker *picker, SplitPoint *sp, int depth, int ply, int inCheck, int futile, int quietsSeen) {
+	int moves = 0;
+	Move move;
+	while ((move = nextMove(picker)) != 0) {
+		moves++;
+		int quiet = isQuietMove(&game->board, move);
+		quietsSeen += quiet;
+		// The eldest brother is move 1
+		int moveNumber = moves + 1;
+		if (quiet && pruneQuiet(depth, inCheck, futile, moveNumber, quietsSeen, sp->bestScore)) {
+			continue;
+		}
+#pragma omp task firstprivate(move, moveNumber, quiet)
+		searchSplitMove(game, sp, move, depth, ply, moveNumber, quiet, inCheck);
+	}
+#pragma omp taskwait
+	return moves;
+}
+
+// The main thread names the move it is on once the search has run this long, in seconds
+#define CURRMOVE_AFTER 1.0
+
+// One pass over the root moves at depth within (alpha, beta), best move into *bestMove and
+// its line into data->pv[0]. Fails soft: a score outside the window is only a bound.
+static int searchRoot(Game *game, SearchData *data, const Move *moveList, int moveCount, int depth, int alpha, int beta, Move *bestMove) {
+	int bestScore = -1000000; // Start with a large negative number
+	data->pvLength[0] = 0;
+
+	for (int i = 0; i < moveCount; i++) {
+		Move move = moveList[i];
+		if (data->id == 0 && omp_get_wtime() - searchStart >= CURRMOVE_AFTER) {
+			char moveUci[6];
+			moveToUCI(move, moveUci);
+			printf("info depth %d currmove %s currmovenumber %d\n", depth, moveUci, i + 1);
+		}
+
+		game_make_move(game, move);
+		tt_prefetch(game->board.zobristKey);
+
+		// Penalty for bishops and knights still on starting squares, taken off the child's score,
+		// so the child's window is shifted by it
+		int adjustment = position_penalty(&game->board, game->board.sideToMove);
+		int childAlpha = -(beta + adjustment);
+		int childBeta = -(alpha + adjustment);
+
+		// PVS as in dfs: the first move with the full window, the rest have to prove they beat it
+		int score;
+		if (i == 0) {
+			score = -dfs(game, data, depth - 1, 1, childAlpha, childBeta, NULL);
+		} else {
+			score = -dfs(game, data, depth - 1, 1, childBeta - 1, childBeta, NULL);
+			if (score > alpha + adjustment && score < beta + adjustment) {
+				score = -dfs(game, data, depth - 1, 1, childAlpha, childBeta, NULL);
+			}
+		}
+		// Mates are exact distances, leave them alone
+		if (score > -MATE_BOUND && score < MATE_BOUND) {
+			score -= adjustment;
+		}
+
+		game_unmake_move(game);
+
+		if (stopSearch) {
+			break;
+		}
+		if (score > bestScore) {
+			*bestMove = move;
+			bestScore = score;
+			if (score > alpha) {
+				alpha = score;
+				updatePv(data, 0, move);
+			} else if (data->pvLength[0] == 0) {
+				// Failing low, the line is only the best guess so far
+				data->pv[0][0] = move;
+				data->pvLength[0] = 1;
+			}
+		}
+		if (alpha >= beta) {
+			break;
+		}
+	}
+
+	return bestScore;
+}
+
+// Lazy SMP staggering: helper i skips the depths where ((depth + skipPhase) / skipSize) is odd,
+// using entry (i - 1) % 20, so the helpers spread over neighbouring iterations instead of all
+// searching the main thread's
+static const int skipSize[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int skipPhase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// Aspiration windows: from this depth on, search around the last score first
+#define ASPIRATION_MIN_DEPTH 5
+#define ASPIRATION_WINDOW 30
+
+// Full principal variation line for the main thread, scores as mate in moves where there is one
+static void reportIteration(const SearchData *data, int depth, int score) {
+	double elapsedTime = omp_get_wtime() - searchStart;
+	unsigned long long nodes = totalNodes();
+	unsigned long long nps = elapsedTime > 0 ? nodes / elapsedTime : 0;
+	if (score >= MATE_BOUND) {
+		printf("info depth %d score mate %d", depth, (MATE_SCORE - score + 1) / 2);
+	} else if (score <= -MATE_BOUND) {
+		printf("info depth %d score mate %d", depth, -(MATE_SCORE + score) / 2);
+	} else {
+		printf("info depth %d score cp %d", depth, score);
+	}
+	printf(" nodes %llu nps %llu time %d pv", nodes, nps, (int)(elapsedTime * 1000));
+	for (int i = 0; i < data->pvLength[0]; i++) {
+		char moveUci[6];
+		moveToUCI(data->pv[0][i], moveUci);
+		printf(" %s", moveUci);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+// Search the best move first, it raises alpha for the rest
+static void moveToFront(Move *moveList, Move move) {
+	int index = 0;
+	while (moveList[index] != move) {
+		index++;
+	}
+	memmove(&moveList[1], &moveList[0], index * sizeof(Move));
+	moveList[0] = move;
+}
+
+// Iterative deepening for one thread. The main thread's completed iterations decide the move;
+// helpers run until it stops them, sharing what they find only through the hash table.
+static Move iterativeDeepening(Game *game, SearchData *data, const Move *rootMoves, int moveCount, int maxDepth) {
+	Move moveList[MAX_MOVES];
+	memcpy(moveList, rootMoves, moveCount * sizeof(Move));
+
+	// Best move of the last completed iteration; an iteration cut short by a limit is thrown away
+	Move bestMove = moveList[0];
+	int previousScore = 0;
+
+	for (int depth = 1; depth <= maxDepth && !stopSearch; depth++) {
+		if (data->id > 0) {
+			int entry = (data->id - 1) % 20;
+			if (((depth + skipPhase[entry]) / skipSize[entry]) % 2) {
+				continue;
+			}
+		}
+
+		// Scores rarely move far between iterations; a narrow window around the last one
+		// cuts more, and a score falling outside it is searched again with that side widened
+		int window = ASPIRATION_WINDOW;
+		int alpha = -1000000;
+		int beta = 1000000;
+		if (depth >= ASPIRATION_MIN_DEPTH && previousScore > -MATE_BOUND && previousScore < MATE_BOUND) {
+			alpha = previousScore - window;
+			beta = previousScore + window;
+		}
+
+		Move iterationBest = moveList[0];
+		int bestScore;
+		while (1) {
+			bestScore = searchRoot(game, data, moveList, moveCount, depth, alpha, beta, &iterationBest);
+			if (stopSearch) {
+				break;
+			}
+			window *= 2;
+			if (bestScore <= alpha) {
+				alpha = bestScore - window > -1000000 ? bestScore - window : -1000000;
+			} else if (bestScore >= beta) {
+				beta = bestScore + window < 1000000 ? bestScore + window : 1000000;
+				moveToFront(moveList, iterationBest);
+			} else {
+				break;
+			}
+		}
+		if (stopSearch) {
+			break;
+		}
+		bestMove = iterationBest;
+		previousScore = bestScore;
+		moveToFront(moveList, bestMove);
+
+		if (data->id == 0) {
+			reportIteration(data, depth, bestScore);
+
+			double elapsedTime = omp_get_wtime() - searchStart;
+			if (softDeadline > 0 && elapsedTime >= softDeadline / 2) {
+				break;
+			}
+		}
+	}
+
+	return bestMove;
+}
+
 Move searchBestMove(Game *game, const char *goCommand, int depth) {
 	// Initialize variables at the start of each search
-	nodeCount = 0;
-	clock_t startTime = omp_get_wtime();
+	stopSearch = 0;
+	tt_new_search();
+	searchStart = omp_get_wtime();
 
-	if (!goCommand) {
-	};
+	// A bare go (or none, from bench) searches to the Depth option, as before
+	SearchLimits limits = {0};
+	if (goCommand != NULL) {
+		parseGoCommand(goCommand, &limits);
+	}
+	int side = game->board.sideToMove;
+	int timed = limits.movetime > 0 || limits.time[side] > 0;
+	int maxDepth = limits.depth > 0 ? limits.depth : (timed || limits.nodes || limits.infinite) ? MAX_PLY - 1 : depth;
+	// Every ply of a line is a move pushed onto the game, which only has room for MAX_PLY of them
+	maxDepth = maxDepth < MAX_PLY - 1 ? maxDepth : MAX_PLY - 1;
+	allocateTime(&limits, side);
+	nodeLimit = limits.nodes;
+	// Any go listens for stop; bench searches without one
+	watchInput = goCommand != NULL;
+	infiniteSearch = limits.infinite;
 
 	// Generate all legal moves
 	Move moveList[MAX_MOVES];
@@ -86,54 +899,59 @@ Move searchBestMove(Game *game, const char *goCommand, int depth) {
 	// If there are no legal moves, this is a checkmate or stalemate.
 	// Handle this case in some appropriate way. Here, I'll just return a dummy move.
 	if (moveCount == 0) {
+		nodeCount = 0;
 		return 0;
 	}
 
-	// For each legal move, make that move, then use dfs to search the resulting position.
-	// Keep track of the best move and its score.
-	Move bestMove = moveList[0];
-	int bestScore = -1000000; // Start with a large negative number
-	int alpha = -1000000;
-	int beta = 1000000;
-
-#pragma omp parallel for
-	for (int i = 0; i < moveCount; i++) {
-		// Make a copy of the game and make the move on the copy
-		Game tempGame = *game;
-		game_make_move(&tempGame, moveList[i]);
-
-		// Use dfs to search the resulting position
-		int score = -dfs(&tempGame, depth - 1, -beta, -alpha); // Note the minus sign here
-
-		// Penalty for bishops and knights still on starting squares
-		int adjustment = position_penalty(&tempGame.board, tempGame.board.sideToMove);
-		score -= adjustment;
-
-		// Evaluation information
-		// Convert the best move to UCI format
-		char bestMoveUci[6];
-		moveToUCI(bestMove, bestMoveUci);
+	// Killers are about the previous position's tree, history fades by half each move
+	activeThreads = searchThreads;
+	for (int i = 0; i < activeThreads; i++) {
+		SearchData *data = &searchData[i];
+		data->id = i;
+		data->nodes = 0;
+		memset(data->killers, 0, sizeof(data->killers));
+		for (int side = 0; side < 2; side++) {
+			for (int from = 0; from < 64; from++) {
+				for (int to = 0; to < 64; to++) {
+					data->history[side][from][to] /= 2;
+				}
+			}
+		}
+	}
 
-		char thisMoveUci[6];
-		moveToUCI(moveList[i], thisMoveUci);
+	Move bestMove = moveList[0];
 
-		// Performance report
-		double currentTime = omp_get_wtime();
+#pragma omp parallel num_threads(activeThreads)
+	{
+		SearchData *threadSearch = &searchData[omp_get_thread_num()];
 
-		double elapsedTime = currentTime - startTime;
-		unsigned long long nps = elapsedTime > 0 ? nodeCount / elapsedTime : 0;
+		if (threadSearch->id == 0) {
+			// Each thread searches on its own copy of the game, 64-byte aligned like the Board in it
+			Game *threadGame = aligned_alloc(64, sizeof(Game));
+			game_copy(threadGame, game);
+			bestMove = iterativeDeepening(threadGame, threadSearch, moveList, moveCount, maxDepth);
+			free(threadGame);
 
-#pragma omp critical
-		{
-			if (score > bestScore) {
-				bestMove = moveList[i];
-				bestScore = score;
-				alpha = score;
+			// go infinite must not answer before stop, even when the depth ran out
+			while (limits.infinite && !stopSearch) {
+				usleep(1000);
+				pollInput();
 			}
+			// Done: call off the helpers
+			stopSearch = 1;
+		} else if (searchMode == SEARCH_LAZY_SMP) {
+			Game *threadGame = aligned_alloc(64, sizeof(Game));
+			game_copy(threadGame, game);
+			iterativeDeepening(threadGame, threadSearch, moveList, moveCount, MAX_PLY - 1);
+			free(threadGame);
 		}
-		printf("info depth %d score cp %d thismove %s thismovescore %d penalty %d nodes %llu nps %llu pv %s\n", depth, bestScore, thisMoveUci, score, adjustment, nodeCount, nps, bestMoveUci);
+		// In YBWC mode the other threads go straight to the barrier closing the region,
+		// where they run the tasks the main thread's split points hand out
 	}
 
+	nodeCount = totalNodes();
+	activeThreads = 0;
+
 	// After searching all moves, return the best move found
 	return bestMove;
 }
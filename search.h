@@ -4,6 +4,36 @@
 #include "game.h"
 #include "move.h"
 
+// Nodes visited by the last searchBestMove
+extern unsigned long long nodeCount;
+// Set when quit arrives during a search; the caller should exit after answering bestmove
+extern int quitRequested;
+
+// Fill the late-move reduction table, call once at startup
+void init_search();
+
+// Switches for the selective search (NullMove, LMR, Futility, ReverseFutility,
+// LateMovePruning), all on by default. search_option_name returns NULL past the last one,
+// search_set_option returns 0 for an unknown name.
+const char *search_option_name(int index);
+int search_set_option(const char *name, int enabled);
+
+// How extra threads help the search:
+// SEARCH_LAZY_SMP: every thread runs its own iterative deepening, sharing only the hash table
+// SEARCH_YBWC: one search whose nodes, once their first move is searched, split the rest across threads
+enum { SEARCH_LAZY_SMP, SEARCH_YBWC };
+void search_set_mode(int mode);
+
+// Number of search threads, clamped to 1..256, default 1
+void search_set_threads(int threads);
+int search_threads();
+
+// Forget the move ordering history, for a new game
+void search_clear();
+
+// Iterative deepening under the limits of goCommand (wtime btime winc binc movestogo movetime
+// depth nodes infinite), returning the best move of the last completed iteration. Without
+// any limit, or with goCommand NULL, it searches to depth.
 Move searchBestMove(Game *game, const char *goCommand, int depth);
 
 #endif
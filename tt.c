@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tt.h"
+
+TTBucket *ttTable = NULL;
+uint64_t ttMask = 0;
+
+static uint8_t generation = 0; // 6 bits, wraps
+
+uint64_t tt_bucket_count(size_t megabytes, size_t bucketSize) {
+	uint64_t buckets = 1;
+	while (buckets * 2 * bucketSize <= megabytes * 1024 * 1024) {
+		buckets *= 2;
+	}
+	return buckets;
+}
+
+void tt_resize(size_t megabytes) {
+	uint64_t buckets = tt_bucket_count(megabytes, sizeof(TTBucket));
+	TTBucket *table = aligned_alloc(64, buckets * sizeof(TTBucket));
+	if (table == NULL) {
+		printf("info string Failed to allocate %zu MB for the hash table\n", megabytes);
+		return;
+	}
+	free(ttTable);
+	ttTable = table;
+	ttMask = buckets - 1;
+	tt_clear();
+}
+
+void tt_clear() {
+	memset(ttTable, 0, (ttMask + 1) * sizeof(TTBucket));
+	generation = 0;
+}
+
+void tt_new_search() {
+	generation = (generation + 1) & 63;
+}
+
+#define DATA_MOVE(data) ((Move)((data) & 0xFFFF))
+#define DATA_DEPTH(data) ((int)(((data) >> 16) & 0xFF))
+#define DATA_BOUND(data) ((int)(((data) >> 24) & 3))
+#define DATA_GENERATION(data) ((int)(((data) >> 26) & 63))
+#define DATA_SCORE(data) ((int)(int32_t)((data) >> 32))
+
+int tt_probe(uint64_t key, TTHit *hit) {
+	TTBucket *bucket = &ttTable[key & ttMask];
+	for (int i = 0; i < 4; i++) {
+		uint64_t entryKey = __atomic_load_n(&bucket->entries[i].key, __ATOMIC_RELAXED);
+		uint64_t data = __atomic_load_n(&bucket->entries[i].data, __ATOMIC_RELAXED);
+		if ((entryKey ^ data) == key && DATA_BOUND(data) != TT_NONE) {
+			hit->move = DATA_MOVE(data);
+			hit->depth = DATA_DEPTH(data);
+			hit->bound = DATA_BOUND(data);
+			hit->score = DATA_SCORE(data);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Overwrite the position's own entry if it is there, otherwise the entry
+// worth least: shallow and left over from earlier searches
+void tt_store(uint64_t key, Move move, int depth, int bound, int score) {
+	TTBucket *bucket = &ttTable[key & ttMask];
+	TTEntry *replace = NULL;
+	int replaceWorth = 1 << 30;
+
+	for (int i = 0; i < 4; i++) {
+		TTEntry *entry = &bucket->entries[i];
+		uint64_t entryKey = __atomic_load_n(&entry->key, __ATOMIC_RELAXED);
+		uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+		if ((entryKey ^ data) == key) {
+			// Keep the old best move when this search didn't find one
+			if (move == 0) {
+				move = DATA_MOVE(data);
+			}
+			replace = entry;
+			break;
+		}
+		int age = (generation - DATA_GENERATION(data)) & 63;
+		int worth = DATA_BOUND(data) == TT_NONE ? -1000 : DATA_DEPTH(data) - 8 * age;
+		if (worth < replaceWorth) {
+			replace = entry;
+			replaceWorth = worth;
+		}
+	}
+
+	uint64_t data = (uint64_t)(uint32_t)score << 32 | (uint64_t)generation << 26 | (uint64_t)bound << 24 | (uint64_t)(depth & 0xFF) << 16 | move;
+	__atomic_store_n(&replace->key, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&replace->data, data, __ATOMIC_RELAXED);
+}
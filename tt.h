@@ -0,0 +1,54 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "move.h"
+
+#define TT_DEFAULT_MB 16
+
+// What a stored score says about the true score
+enum { TT_NONE = 0, TT_UPPER, TT_LOWER, TT_EXACT };
+
+typedef struct {
+  Move move;
+  int depth;
+  int bound;
+  int score;
+} TTHit;
+
+// Largest power of two number of buckets of bucketSize bytes that fits in megabytes, at least one.
+// Also sizes the perft table.
+uint64_t tt_bucket_count(size_t megabytes, size_t bucketSize);
+// Size the table to the largest power of two buckets that fits, and clear it.
+// On allocation failure the previous table is kept.
+void tt_resize(size_t megabytes);
+void tt_clear();
+// Start a new search: entries from older searches become the first to be replaced
+void tt_new_search();
+
+int tt_probe(uint64_t key, TTHit *hit);
+void tt_store(uint64_t key, Move move, int depth, int bound, int score);
+
+// Shared by all search threads without locks: key is stored XORed with data, so an entry
+// torn by two threads writing at once fails the key check and reads as a miss.
+// The perft table works the same way.
+typedef struct {
+  uint64_t key;  // zobristKey ^ data
+  uint64_t data; // score << 32 | generation << 26 | bound << 24 | depth << 16 | move
+} TTEntry;
+
+// Four entries fill one cache line
+typedef struct {
+  TTEntry entries[4];
+} __attribute__((aligned(64))) TTBucket;
+
+extern TTBucket *ttTable;
+extern uint64_t ttMask;
+
+// Start loading a position's bucket, e.g. right after make_move so it is in cache by the probe
+static inline void tt_prefetch(uint64_t key) {
+	__builtin_prefetch(&ttTable[key & ttMask]);
+}
+
+#endif
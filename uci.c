@@ -1,13 +1,18 @@
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "uci.h"
+#include "bench.h"
 #include "board.h"
+#include "cpu.h"
 #include "evaluate.h"
 #include "game.h"
 #include "move.h"
 #include "perft.h"
 #include "search.h"
+#include "tt.h"
 
 Move uciToMove(Board *board, const char *str) {
 	unsigned int from = (str[0] - 'a') + 8 * (str[1] - '1');
@@ -38,7 +43,7 @@ Move uciToMove(Board *board, const char *str) {
 
 	// Find the move in the move list that matches the from, to, and promotion pieces
 	for (int i = 0; i < moveCount; i++) {
-		if (FROM_SQUARE(moveList[i]) == from && TO_SQUARE(moveList[i]) == to && PROMOTED_PIECE(moveList[i]) == promotion) {
+		if (FROM_SQUARE(moveList[i]) == from && TO_SQUARE(moveList[i]) == to && (unsigned int)PROMOTED_PIECE(moveList[i]) == promotion) {
 			return moveList[i];
 		}
 	}
@@ -79,6 +84,78 @@ void moveToUCI(Move move, char *str) {
 	str[5] = '\0';
 }
 
+// stdin is read with read() into this buffer, never through stdio: poll() can't see lines
+// stdio has already buffered. The search takes the commands it answers from the front,
+// anything else stays queued here for uciLoop.
+#define INPUT_BUFFER_SIZE 65536
+static char input[INPUT_BUFFER_SIZE];
+static int inputLength;
+static int inputClosed;
+
+// Append what stdin has to the buffer; without wait, only if that doesn't block
+static void fillInput(int wait) {
+	if (inputClosed || inputLength == INPUT_BUFFER_SIZE) {
+		return;
+	}
+	struct pollfd pending = {.fd = STDIN_FILENO, .events = POLLIN};
+	if (!wait && poll(&pending, 1, 0) <= 0) {
+		return;
+	}
+	ssize_t bytes = read(STDIN_FILENO, input + inputLength, INPUT_BUFFER_SIZE - inputLength);
+	if (bytes <= 0) {
+		inputClosed = 1;
+	} else {
+		inputLength += bytes;
+	}
+}
+
+// Length of the first queued line including its newline, 0 if it isn't complete yet.
+// A full buffer or closed input ends the last line anyway.
+static int lineLength() {
+	char *newline = memchr(input, '\n', inputLength);
+	if (newline != NULL) {
+		return newline - input + 1;
+	}
+	return (inputClosed || inputLength == INPUT_BUFFER_SIZE) ? inputLength : 0;
+}
+
+// Copy the first line out of the buffer, without its newline, and drop it from the buffer
+static void takeLine(int length, char *line, int size) {
+	int copied = input[length - 1] == '\n' ? length - 1 : length;
+	copied = copied < size - 1 ? copied : size - 1;
+	memcpy(line, input, copied);
+	line[copied] = '\0';
+	memmove(input, input + length, inputLength - length);
+	inputLength -= length;
+}
+
+// Next command for uciLoop, waiting for one. Returns 0 once stdin is closed and drained.
+int uciReadLine(char *line, int size) {
+	int length;
+	while ((length = lineLength()) == 0 && !inputClosed) {
+		fillInput(1);
+	}
+	if (length == 0) {
+		return 0;
+	}
+	takeLine(length, line, size);
+	return 1;
+}
+
+// The queued stop, quit or isready at the front of the queue, without waiting. Returns 1
+// with it in line, 0 if there is none, -1 if there is none and never will be: stdin is
+// closed with nothing queued. Behind any other command everything waits for uciLoop, so
+// commands still run in the order they came.
+int uciSearchCommand(char *line, int size) {
+	fillInput(0);
+	int length = lineLength();
+	if (length > 0 && (strncmp(input, "stop", 4) == 0 || strncmp(input, "quit", 4) == 0 || strncmp(input, "isready", 7) == 0)) {
+		takeLine(length, line, size);
+		return 1;
+	}
+	return inputClosed && inputLength == 0 ? -1 : 0;
+}
+
 void uciLoop(Game *game) {
 	int depth = 6;
 	FILE *logFile = fopen("logfile.txt", "w"); // Open a new log file
@@ -92,7 +169,7 @@ void uciLoop(Game *game) {
 	char buffer[4096];
 	Move moveList[MAX_MOVES];
 
-	while (fgets(buffer, sizeof(buffer), stdin) != NULL) {
+	while (uciReadLine(buffer, sizeof(buffer))) {
 		// Remove the newline character
 		buffer[strcspn(buffer, "\n")] = 0;
 
@@ -105,12 +182,20 @@ void uciLoop(Game *game) {
 			printf("id name MyChessEngine\n");
 			printf("id author MyName\n");
 			printf("option name Depth type spin default 6 min 1 max 100\n");
+			printf("option name Hash type spin default %d min 1 max 65536\n", TT_DEFAULT_MB);
+			printf("option name Threads type spin default 1 min 1 max 256\n");
+			printf("option name SMPMode type combo default LazySMP var LazySMP var YBWC\n");
+			for (int i = 0; search_option_name(i) != NULL; i++) {
+				printf("option name %s type check default true\n", search_option_name(i));
+			}
+			printf("info string cpu: %s\n", cpu_path_name());
 			printf("uciok\n");
 			fflush(stdout);
 
 			// Log the output
 			fprintf(logFile, "Output: id name MyChessEngine\n");
 			fprintf(logFile, "Output: id author MyName\n");
+			fprintf(logFile, "Output: info string cpu: %s\n", cpu_path_name());
 			fprintf(logFile, "Output: uciok\n");
 			fflush(logFile);
 		} else if (strcmp(buffer, "isready") == 0) {
@@ -123,6 +208,8 @@ void uciLoop(Game *game) {
 		} else if (strcmp(buffer, "ucinewgame") == 0) {
 			// Initialize a new game
 			game_newGame(game);
+			tt_clear();
+			search_clear();
 			printf("info string New game initialized\n");
 			fflush(stdout);
 
@@ -141,6 +228,55 @@ void uciLoop(Game *game) {
 			}
 			fflush(stdout);
 			fflush(logFile);
+		} else if (strncmp(buffer, "setoption name Hash value ", 26) == 0) {
+			int megabytes = atoi(buffer + 26);
+			if (megabytes >= 1 && megabytes <= 65536) {
+				tt_resize((size_t)megabytes);
+				printf("info string hash set to %d MB\n", megabytes);
+				fprintf(logFile, "Output: Set hash to %d MB\n", megabytes);
+			} else {
+				printf("info string ignored invalid hash setting: %d\n", megabytes);
+				fprintf(logFile, "Output: Ignored invalid hash setting: %d\n", megabytes);
+			}
+			fflush(stdout);
+			fflush(logFile);
+		} else if (strncmp(buffer, "setoption name Threads value ", 29) == 0) {
+			int threads = atoi(buffer + 29);
+			if (threads >= 1 && threads <= 256) {
+				search_set_threads(threads);
+				printf("info string threads set to %d\n", threads);
+				fprintf(logFile, "Output: Set threads to %d\n", threads);
+			} else {
+				printf("info string ignored invalid threads setting: %d\n", threads);
+				fprintf(logFile, "Output: Ignored invalid threads setting: %d\n", threads);
+			}
+			fflush(stdout);
+			fflush(logFile);
+		} else if (strncmp(buffer, "setoption name SMPMode value ", 29) == 0) {
+			if (strcmp(buffer + 29, "LazySMP") == 0 || strcmp(buffer + 29, "YBWC") == 0) {
+				search_set_mode(strcmp(buffer + 29, "YBWC") == 0 ? SEARCH_YBWC : SEARCH_LAZY_SMP);
+				printf("info string SMP mode set to %s\n", buffer + 29);
+				fprintf(logFile, "Output: Set SMP mode to %s\n", buffer + 29);
+			} else {
+				printf("info string ignored invalid SMP mode: %s\n", buffer + 29);
+				fprintf(logFile, "Output: Ignored invalid SMP mode: %s\n", buffer + 29);
+			}
+			fflush(stdout);
+			fflush(logFile);
+		} else if (strncmp(buffer, "setoption name ", 15) == 0 && strstr(buffer, " value ") != NULL) {
+			// The pruning and reduction switches: setoption name <name> value <true | false>
+			char *value = strstr(buffer, " value ");
+			*value = '\0';
+			value += 7;
+			if ((strcmp(value, "true") == 0 || strcmp(value, "false") == 0) && search_set_option(buffer + 15, strcmp(value, "true") == 0)) {
+				printf("info string %s set to %s\n", buffer + 15, value);
+				fprintf(logFile, "Output: Set %s to %s\n", buffer + 15, value);
+			} else {
+				printf("info string ignored unknown option: %s\n", buffer + 15);
+				fprintf(logFile, "Output: Ignored unknown option: %s\n", buffer + 15);
+			}
+			fflush(stdout);
+			fflush(logFile);
 		} else if (strncmp(buffer, "position", 8) == 0) {
 			// We got a "position" command
 			if (strncmp(buffer, "position startpos moves", 22) == 0) {
@@ -151,7 +287,7 @@ void uciLoop(Game *game) {
 				int moveCount = 0; // Counter for the number of moves applied
 				while (move != NULL) {
 					Move internalMove = uciToMove(&game->board, move);
-					game_make_move(game, internalMove);
+					game_play_move(game, internalMove);
 					move = strtok(NULL, " ");
 					moveCount++; // Increment the counter for each move applied
 				}
@@ -199,7 +335,7 @@ void uciLoop(Game *game) {
 					int moveCount = 0; // Counter for the number of moves applied
 					while (move != NULL) {
 						Move internalMove = uciToMove(&game->board, move);
-						game_make_move(game, internalMove);
+						game_play_move(game, internalMove);
 						move = strtok(NULL, " ");
 						moveCount++; // Increment the counter for each move  applied
 					}
@@ -226,7 +362,7 @@ void uciLoop(Game *game) {
 			// Check if a valid move was found
 			if (bestMove != 0) {
 				// Make the chosen move
-				game_make_move(game, bestMove);
+				game_play_move(game, bestMove);
 
 				// Send the chosen move to the user interface
 				char uciMove[6];
@@ -241,6 +377,11 @@ void uciLoop(Game *game) {
 
 				fprintf(logFile, "info string No legal moves\n");
 			}
+			if (quitRequested) {
+				break;
+			}
+		} else if (strcmp(buffer, "stop") == 0) {
+			// Only meaningful during a search, where searchBestMove reads it itself
 		} else if (strcmp(buffer, "quit") == 0) {
 			// The "quit" command terminates the loop
 			break;
@@ -260,12 +401,13 @@ void uciLoop(Game *game) {
 				printf("Move %d: from %lu to %lu : ", i + 1, (unsigned long)FROM_SQUARE(moveList[i]), (unsigned long)TO_SQUARE(moveList[i]));
 				printMove(moveList[i]);
 
-				// Make a copy of the board and make the move on the copy
-				Board tempBoard = game->board;
-				make_move(&tempBoard, moveList[i]);
+				// Make the move, evaluate, take it back
+				Undo undo;
+				make_move(&game->board, moveList[i], &undo);
 
 				// Use evaluate to get the static evaluation score
-				int score = evaluate(&tempBoard);
+				int score = evaluate(&game->board);
+				unmake_move(&game->board, &undo);
 
 				printf(" | Eval Score: %d", score);
 				printf("\n");
@@ -273,9 +415,24 @@ void uciLoop(Game *game) {
 		} else if (strncmp(buffer, "perftEPD", 8) == 0) {
 			// We got a "perftEPD" command
 			char *filePath = strdup(buffer + 9); // Copy the rest of the string after "perftEPD "
-			printf("info string Received EPD file path: %s\n", filePath);
-			perftFromEPD(filePath);
+			// An optional trailing number is the maximum depth
+			int maxDepth = 0;
+			char *lastSpace = strrchr(filePath, ' ');
+			if (lastSpace != NULL && lastSpace[1] != '\0' && strspn(lastSpace + 1, "0123456789") == strlen(lastSpace + 1)) {
+				maxDepth = atoi(lastSpace + 1);
+				*lastSpace = '\0';
+			}
+			// Nothing else is printed, the output is JSON lines only
+			perftFromEPD(filePath, maxDepth);
 			free(filePath);
+		} else if (strncmp(buffer, "perft divide", 12) == 0) {
+			// Per root move counts, for comparing against another engine's divide
+			int depth = atoi(buffer + 12);
+			if (depth <= 0) {
+				printf("info string Invalid perft depth: %d\n", depth);
+			} else {
+				perftDivide(game, depth);
+			}
 		} else if (strncmp(buffer, "perft", 5) == 0) {
 			// We got a "perft" command
 			int depth = atoi(buffer + 6); // Convert the rest of the string after "perft " to an integer
@@ -283,24 +440,59 @@ void uciLoop(Game *game) {
 				printf("info string Invalid perft depth: %d\n", depth);
 			} else {
 				printf("info string Performing perft to depth %d\n", depth);
-				uint64_t perftResult = performPerft(game, depth);
-				printf("info string Perft result: %lu\n", perftResult);
+				if (strstr(buffer + 6, "categories") != NULL) {
+					// Slower, also classifies the last-ply moves
+					PerftResult perftResult = performPerftCategories(game, depth);
+					printf("info string Perft result: %lu\n", perftResult.nodes);
+					printf("info string Captures: %lu, en passant: %lu, castles: %lu, promotions: %lu\n", perftResult.captures, perftResult.enPassants,
+						   perftResult.castlings, perftResult.promotions);
+				} else {
+					// "hash <MB>" caches subtree counts for this run, "split <plies>" sets the task depth
+					const char *hash = strstr(buffer + 6, "hash");
+					const char *split = strstr(buffer + 6, "split");
+					if (hash != NULL) {
+						perft_set_hash((size_t)atoi(hash + 4));
+					}
+					if (split != NULL) {
+						perft_set_split(atoi(split + 5));
+					}
+					uint64_t perftResult = performPerft(game, depth);
+					printf("info string Perft result: %lu\n", perftResult);
+					perft_print_thread_summary();
+					if (hash != NULL) {
+						perft_set_hash(0);
+					}
+				}
+			}
+		} else if (strncmp(buffer, "bench", 5) == 0) {
+			// Fixed positions, fixed depth, one thread: the node total should not change between runs
+			int depth = buffer[5] != '\0' ? atoi(buffer + 6) : BENCH_DEFAULT_DEPTH;
+			if (depth <= 0) {
+				printf("info string Invalid bench depth: %d\n", depth);
+			} else {
+				bench(depth);
 			}
 		} else if (strncmp(buffer, "help", 4) == 0) {
 			printf(" uci\n");
 			printf(" isready\n");
 			printf(" ucinewgame\n");
 			printf(" setoption name Depth value <n>\n");
+			printf(" setoption name Hash value <MB>\n");
+			printf(" setoption name Threads value <n>\n");
+			printf(" setoption name SMPMode value <LazySMP | YBWC>\n");
+			printf(" setoption name <NullMove | LMR | Futility | ReverseFutility | LateMovePruning> value <true | false>\n");
 			printf(" position startpos\n");
 			printf(" position startpos [moves ...]\n");
 			printf(" position <fen>\n");
 			printf(" position <fen> [moves ...]\n");
-			printf(" go\n");
+			printf(" go [wtime <ms> btime <ms> winc <ms> binc <ms> movestogo <n> | movetime <ms> | depth <n> | nodes <n> | infinite]\n");
 			printf(" quit\n");
 			printf(" print\n");
 			printf(" movelist\n");
-			printf(" perftEPD <filename>\n");
-			printf(" perft <n>\n");
+			printf(" perftEPD <filename> [max depth]\n");
+			printf(" perft <n> [categories | hash <MB> split <plies>]\n");
+			printf(" perft divide <n>\n");
+			printf(" bench [depth]\n");
 		} else {
 			printf("info string Received unknown command: %s\n", buffer);
 		}
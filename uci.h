@@ -6,5 +6,7 @@
 
 void uciLoop(Game *game);
 void moveToUCI(Move move, char *str);
+int uciReadLine(char *line, int size);
+int uciSearchCommand(char *line, int size);
 
 #endif
@@ -1,44 +1,48 @@
-#include <stdlib.h>
 #include "zobrist.h"
 
-// 6 for different piece types, 2 for colors, 64 for different squares
-uint64_t zobrist_piece_keys[6][2][64];
+// Indexed by piece type as in board.h (PAWN = 1 ... KING = 6, slot 0 unused), 2 for colors, 64 for different squares
+uint64_t zobrist_piece_keys[7][2][64];
 // 2 for colors, 2 for castle side (king/queen)
 uint64_t zobrist_castling_keys[2][2];
 
 uint64_t zobrist_ep_keys[8]; // 8 possible files for en passant
 uint64_t zobrist_side_key;	 // Different key for black's turn
 
+// splitmix64 with a fixed seed: full 64-bit keys (rand() only gives 31 bits), the same on every run
+static uint64_t zobristSeed = 0x9E3779B97F4A7C15ULL;
+static uint64_t random_key() {
+	uint64_t z = (zobristSeed += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
 void init_zobrist() {
 	// Randomly initialize the keys using a PRNG
-	for (int piece = 0; piece < 6; ++piece) {
+	for (int piece = 1; piece < 7; ++piece) {
 		for (int color = 0; color < 2; ++color) {
 			for (int square = 0; square < 64; ++square) {
-				zobrist_piece_keys[piece][color][square] = (uint64_t)rand();
+				zobrist_piece_keys[piece][color][square] = random_key();
 			}
 		}
 	}
 	for (int color = 0; color < 2; ++color) {
 		for (int castle_side = 0; castle_side < 2; ++castle_side) {
-			zobrist_castling_keys[color][castle_side] = (uint64_t)rand();
+			zobrist_castling_keys[color][castle_side] = random_key();
 		}
 	}
 	for (int i = 0; i < 8; ++i) {
-		zobrist_ep_keys[i] = (uint64_t)rand();
+		zobrist_ep_keys[i] = random_key();
 	}
-	zobrist_side_key = (uint64_t)rand();
+	zobrist_side_key = random_key();
 }
 
 uint64_t compute_zobrist_key(const Board *board) {
 	uint64_t key = 0;
-	uint64_t pieces[6][2] = {
-		{board->pawns[WHITE], board->pawns[BLACK]}, {board->knights[WHITE], board->knights[BLACK]}, {board->bishops[WHITE], board->bishops[BLACK]},
-		{board->rooks[WHITE], board->rooks[BLACK]}, {board->queens[WHITE], board->queens[BLACK]},	{board->kings[WHITE], board->kings[BLACK]},
-	};
 
-	for (int piece = 0; piece < 6; ++piece) {
+	for (int piece = PAWN; piece <= KING; ++piece) {
 		for (int color = 0; color < 2; ++color) {
-			uint64_t bitboard = pieces[piece][color];
+			uint64_t bitboard = board->bb[color][piece];
 			while (bitboard) {
 				int square = __builtin_ctzll(bitboard); // find the index of the least significant bit
 				key ^= zobrist_piece_keys[piece][color][square];
@@ -65,3 +69,32 @@ uint64_t compute_zobrist_key(const Board *board) {
 
 	return key;
 }
+
+uint64_t compute_pawn_key(const Board *board) {
+	uint64_t key = 0;
+
+	for (int color = 0; color < 2; ++color) {
+		uint64_t bitboard = board->bb[color][PAWN];
+		while (bitboard) {
+			key ^= zobrist_piece_keys[PAWN][color][__builtin_ctzll(bitboard)];
+			bitboard &= bitboard - 1;
+		}
+	}
+
+	return key;
+}
+
+uint64_t compute_material_key(const Board *board) {
+	uint64_t key = 0;
+
+	for (int piece = PAWN; piece <= KING; ++piece) {
+		for (int color = 0; color < 2; ++color) {
+			int count = __builtin_popcountll(board->bb[color][piece]);
+			for (int i = 0; i < count; ++i) {
+				key ^= zobrist_piece_keys[piece][color][i];
+			}
+		}
+	}
+
+	return key;
+}
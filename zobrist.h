@@ -10,4 +10,11 @@ void init_zobrist();
 // Calculate the Zobrist key for a given board
 uint64_t compute_zobrist_key(const Board *board);
 
+// Calculate the key of the pawns only
+uint64_t compute_pawn_key(const Board *board);
+
+// Calculate the key of the material signature: for each color and piece type,
+// zobrist_piece_keys[piece][color][i] for i below the piece count
+uint64_t compute_material_key(const Board *board);
+
 #endif